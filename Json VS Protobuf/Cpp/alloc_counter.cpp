@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc_counter.h"
+
+
+namespace
+{
+
+thread_local std::size_t allocation_count = 0;
+thread_local std::size_t allocation_bytes = 0;
+
+void* counted_malloc(std::size_t size)
+{
+    allocation_count++;
+    allocation_bytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+}
+
+
+std::size_t allocations()
+{
+    return allocation_count;
+}
+
+std::size_t allocated_bytes()
+{
+    return allocation_bytes;
+}
+
+
+// the default operator delete calls free(), so only new is replaced
+
+void* operator new(std::size_t size)
+{
+    void* p = counted_malloc(size);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = counted_malloc(size);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_malloc(size);
+}
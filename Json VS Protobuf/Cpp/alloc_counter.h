@@ -0,0 +1,13 @@
+#ifndef __ALLOC_COUNTER_H__
+#define __ALLOC_COUNTER_H__
+
+#include <cstddef>
+
+// alloc_counter.cpp replaces the global operator new,
+// this returns how many times the calling thread has called it
+std::size_t allocations();
+
+// bytes the calling thread has asked operator new for
+std::size_t allocated_bytes();
+
+#endif // __ALLOC_COUNTER_H__
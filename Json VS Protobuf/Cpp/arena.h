@@ -0,0 +1,221 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// bump allocator for per-request objects.
+// nothing allocated here is ever destroyed one by one, so only
+// trivially destructible types may live in it; reset() frees everything.
+class Arena
+{
+public:
+    explicit Arena(std::size_t chunk_size = 64 * 1024):
+        chunk_size_(chunk_size), head_(NULL), ptr_(NULL), end_(NULL), last_(NULL), chunks_(0)
+    {}
+
+    ~Arena()
+    {
+        release(NULL);
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+    {
+        char* p = align_up(ptr_, align);
+        if(!p || p + size > end_)
+        {
+            add_chunk(size + align);
+            p = align_up(ptr_, align);
+        }
+
+        ptr_ = p + size;
+        last_ = p;
+        return p;
+    }
+
+    template<class T>
+    T* allocate_array(std::size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    template<class T, class... Args>
+    T* make(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // resize the array `p` from `old_n` to `new_n` elements.
+    // grows in place when `p` is the latest allocation, copies otherwise.
+    template<class T>
+    T* grow(T* p, std::size_t old_n, std::size_t new_n)
+    {
+        char* c = reinterpret_cast<char*>(p);
+        if(p && c == last_ && c + sizeof(T) * new_n <= end_)
+        {
+            ptr_ = c + sizeof(T) * new_n;
+            return p;
+        }
+
+        T* q = allocate_array<T>(new_n);
+        if(old_n)
+        {
+            std::memcpy(static_cast<void*>(q), p, sizeof(T) * old_n);
+        }
+        return q;
+    }
+
+    std::string_view copy(std::string_view s)
+    {
+        char* p = static_cast<char*>(allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return std::string_view(p, s.size());
+    }
+
+    // drop everything but keep the newest (largest) chunk for the next request
+    void reset()
+    {
+        release(head_);
+        if(head_)
+        {
+            ptr_ = reinterpret_cast<char*>(head_ + 1);
+            end_ = ptr_ + head_->size;
+        }
+        last_ = NULL;
+    }
+
+    // chunks obtained from the heap so far
+    std::size_t chunks() const
+    {
+        return chunks_;
+    }
+
+private:
+    struct Chunk
+    {
+        Chunk* next;
+        std::size_t size;
+    };
+
+    static char* align_up(char* p, std::size_t align)
+    {
+        auto v = reinterpret_cast<std::uintptr_t>(p);
+        return reinterpret_cast<char*>((v + align - 1) & ~(align - 1));
+    }
+
+    void add_chunk(std::size_t need)
+    {
+        std::size_t size = need > chunk_size_ ? need : chunk_size_;
+        // later chunks double, so a steady workload settles on one chunk
+        if(head_ && head_->size * 2 > size)
+        {
+            size = head_->size * 2;
+        }
+
+        auto chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+        chunk->next = head_;
+        chunk->size = size;
+        head_ = chunk;
+        chunks_++;
+
+        ptr_ = reinterpret_cast<char*>(chunk + 1);
+        end_ = ptr_ + size;
+    }
+
+    // free every chunk after `keep`
+    void release(Chunk* keep)
+    {
+        Chunk* c = keep ? keep->next : head_;
+        while(c)
+        {
+            Chunk* next = c->next;
+            ::operator delete(c);
+            c = next;
+        }
+        if(keep)
+        {
+            keep->next = NULL;
+        }
+        else
+        {
+            head_ = NULL;
+        }
+    }
+
+    std::size_t chunk_size_;
+    Chunk* head_;
+    char* ptr_;
+    char* end_;
+    char* last_;
+    std::size_t chunks_;
+};
+
+
+// read only view of an array living in an Arena
+template<class T>
+struct Span
+{
+    const T* data;
+    std::size_t size;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](std::size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+
+// append-only array in an Arena
+template<class T>
+class ArenaArray
+{
+public:
+    ArenaArray(Arena& arena, std::size_t reserve = 8):
+        arena_(arena), data_(NULL), size_(0), capacity_(0)
+    {
+        if(reserve)
+        {
+            data_ = arena_.allocate_array<T>(reserve);
+            capacity_ = reserve;
+        }
+    }
+
+    T& emplace_back()
+    {
+        if(size_ == capacity_)
+        {
+            std::size_t n = capacity_ ? capacity_ * 2 : 8;
+            data_ = arena_.grow(data_, size_, n);
+            capacity_ = n;
+        }
+        return *new (&data_[size_++]) T();
+    }
+
+    void push_back(const T& v)
+    {
+        emplace_back() = v;
+    }
+
+    Span<T> span() const
+    {
+        return Span<T>{data_, size_};
+    }
+
+private:
+    Arena& arena_;
+    T* data_;
+    std::size_t size_;
+    std::size_t capacity_;
+};
+
+#endif // __ARENA_H__
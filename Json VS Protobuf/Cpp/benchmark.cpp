@@ -0,0 +1,1006 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "json_vs_proto.h"
+#include "alloc_counter.h"
+#include "gzip.h"
+#include "dict_compress.h"
+#include "gzip_stream.h"
+#include "harness.h"
+#include "records.h"
+
+
+void usage()
+{
+    std::cout << "usage: ./benchmark pack   [LOG AMOUNT] [BENCHMARK TIMES] [--threads N|all]" << std::endl;
+    std::cout << "       ./benchmark unpack [BENCHMARK TIMES] [--threads N|all]" << std::endl;
+    std::cout << "       ./benchmark lazy   [LOG AMOUNT] [BENCHMARK TIMES]" << std::endl;
+    std::cout << "       ./benchmark simd   [BENCHMARK TIMES]" << std::endl;
+    std::cout << "       ./benchmark stream [LOG AMOUNT] [BENCHMARK TIMES]" << std::endl;
+    std::cout << "       ./benchmark harness [SAMPLES] [RESULTS FILE]" << std::endl;
+    std::cout << "       ./benchmark varint [MILLION VALUES]" << std::endl;
+    std::cout << "       ./benchmark dict   [BENCHMARK TIMES]" << std::endl;
+    std::cout << "       ./benchmark write-flat" << std::endl;
+    std::cout << "       ./benchmark write-records [RECORDS] [LOG AMOUNT]" << std::endl;
+    std::cout << "       ./benchmark records [THREADS]" << std::endl;
+    exit(1);
+}
+
+int to_int(const char* s)
+{
+    char* end;
+    long v = std::strtol(s, &end, 10);
+    if(*s == '\0' || *end != '\0')
+    {
+        usage();
+    }
+    return static_cast<int>(v);
+}
+
+template<class F>
+double timeit(F func, int times)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<times; i++)
+    {
+        func();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// seconds, plus heap allocations per call
+template<class F>
+void measure(const char* label, F func, int times)
+{
+    std::size_t before = allocations();
+    double seconds = timeit(func, times);
+    double allocs = static_cast<double>(allocations() - before) / times;
+
+    std::cout << std::left << std::setw(25) << label << ": " << std::setw(12) << seconds
+              << " Allocs/Msg: " << allocs << std::endl;
+}
+
+// reads every log, so lazy decoding pays for all of them
+int64_t touch_logs(lazy::Person* m)
+{
+    int64_t sum = 0;
+    for(auto& log: m->logs())
+    {
+        sum += log.times + log.content.size();
+    }
+    return sum;
+}
+
+// same for the flat layout, which has nothing to decode
+int64_t touch_logs(const flat::Person& m)
+{
+    int64_t sum = 0;
+    for(std::size_t i=0; i<m.logs_size(); i++)
+    {
+        auto log = m.log(i);
+        sum += log.times() + log.content().size();
+    }
+    return sum;
+}
+
+volatile int64_t sink;
+
+
+void pack_benchmark(int amount, int times)
+{
+    Pack p(amount);
+
+    std::cout << "LogAmount = " << amount << std::endl;
+    std::cout << "Protobuf Size     : " << p.create_pb().size() << std::endl;
+    std::cout << "Json Size         : " << p.create_json().size() << std::endl;
+    std::cout << "Json GZip Size    : " << p.create_json_gzip().size() << std::endl;
+    std::string buffer;
+    std::cout << "Codec Pb Size     : " << p.create_codec_pb(buffer) << std::endl;
+    std::cout << "Codec Json Size   : " << p.create_codec_json(buffer) << std::endl;
+    std::cout << "Flat Size         : " << p.create_flat(buffer) << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Benchmark Times = " << times << std::endl;
+    std::cout << "Protobuf Seconds  : " << timeit([&p]() { p.create_pb(); }, times) << std::endl;
+    std::cout << "Json Seconds      : " << timeit([&p]() { p.create_json(); }, times) << std::endl;
+    std::cout << "Json GZip Seconds : " << timeit([&p]() { p.create_json_gzip(); }, times) << std::endl;
+    std::cout << "Codec Pb Seconds  : " << timeit([&p, &buffer]() { p.create_codec_pb(buffer); }, times) << std::endl;
+    std::cout << "Codec Json Seconds: " << timeit([&p, &buffer]() { p.create_codec_json(buffer); }, times) << std::endl;
+    std::cout << "Flat Seconds      : " << timeit([&p, &buffer]() { p.create_flat(buffer); }, times) << std::endl;
+}
+
+void unpack_benchmark(int times)
+{
+    UnPack p(project_path());
+
+    std::cout << "Benchmark Times = " << times << std::endl;
+    std::cout << "Protobuf Seconds  : " << timeit([&p]() { p.unpack_pb(); }, times) << std::endl;
+    std::cout << "Json Seconds      : " << timeit([&p]() { p.unpack_json(); }, times) << std::endl;
+    std::cout << "Json GZip Seconds : " << timeit([&p]() { p.unpack_json_gzip(); }, times) << std::endl;
+
+    // a new Person every call, like the protobuf message above
+    std::cout << "Codec Pb Seconds  : " << timeit([&p]() { codec::Person person; p.unpack_codec_pb(person); }, times) << std::endl;
+    std::cout << "Codec Json Seconds: " << timeit([&p]() { codec::Person person; p.unpack_codec_json(person); }, times) << std::endl;
+
+    simd_json::Parser parser;
+    std::cout << "Simd Json Seconds : " << timeit([&p, &parser]() { codec::Person person; p.unpack_simd_json(parser, person); }, times) << std::endl;
+
+    Arena arena;
+    std::cout << "Lazy Pb Seconds   : " << timeit([&p, &arena]() { sink = touch_logs(p.unpack_lazy_pb(arena)); arena.reset(); }, times) << std::endl;
+    std::cout << "Lazy Json Seconds : " << timeit([&p, &arena]() { sink = touch_logs(p.unpack_lazy_json(arena)); arena.reset(); }, times) << std::endl;
+    std::cout << "Stream Gz Seconds : " << timeit([&p]() { codec::Person person; p.unpack_stream_json_gzip(person); }, times) << std::endl;
+
+    // no decode, the time is reading every log in place
+    std::cout << "Flat Seconds      : " << timeit([&p]() { sink = touch_logs(p.unpack_flat(false)); }, times) << std::endl;
+    std::cout << "Flat Check Seconds: " << timeit([&p]() { sink = touch_logs(p.unpack_flat(true)); }, times) << std::endl;
+}
+
+// data.json through every json path, as parse rate
+void simd_benchmark(int times)
+{
+    UnPack p(project_path());
+    const std::string& data = p.data_json();
+    double bytes = static_cast<double>(data.size()) * times;
+
+    auto gbps = [bytes](double seconds)
+    {
+        return bytes / seconds / 1e9;
+    };
+
+    std::cout << "Benchmark Times = " << times << std::endl;
+    std::cout << "Json Size         : " << data.size() << std::endl;
+    std::cout << std::endl;
+
+    codec::Person person;
+    std::cout << "Json GB/s         : " << gbps(timeit([&p]() { p.unpack_json(); }, times)) << std::endl;
+    std::cout << "Codec Json GB/s   : " << gbps(timeit([&p, &person]() { p.unpack_codec_json(person); }, times)) << std::endl;
+
+    auto best = simd_json::detect_kernel();
+    for(int k=simd_json::SCALAR; k<=best; k++)
+    {
+        auto kernel = static_cast<simd_json::Kernel>(k);
+        simd_json::set_kernel(kernel);
+
+        std::vector<uint32_t> index;
+        std::size_t count;
+        bool escapes;
+        simd_json::Parser parser;
+        std::string name = simd_json::kernel_name(kernel);
+        name.resize(6, ' ');
+
+        std::cout << "Index " << name << " GB/s : "
+                  << gbps(timeit([&data, &index, &count, &escapes]() { simd_json::build_index(data.data(), data.size(), index, count, escapes); }, times))
+                  << std::endl;
+        std::cout << "Simd " << name << " GB/s  : "
+                  << gbps(timeit([&p, &parser, &person]() { p.unpack_simd_json(parser, person); }, times))
+                  << std::endl;
+    }
+    simd_json::set_kernel(best);
+}
+
+void lazy_benchmark(int amount, int times)
+{
+    Pack p(amount);
+    std::string pb_data = p.create_pb();
+    std::string json_data;
+    p.create_codec_json(json_data);
+
+    std::cout << "LogAmount = " << amount << std::endl;
+    std::cout << "Protobuf Size     : " << pb_data.size() << std::endl;
+    std::cout << "Json Size         : " << json_data.size() << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Benchmark Times = " << times << std::endl;
+
+    measure("Protobuf", [&pb_data]()
+            {
+                Person msg;
+                msg.ParseFromString(pb_data);
+            }, times);
+
+    measure("Codec Pb", [&pb_data]()
+            {
+                codec::Person person;
+                codec::pb_decode(pb_data.data(), pb_data.size(), person);
+            }, times);
+
+    Arena arena;
+    measure("Lazy Pb (id only)", [&pb_data, &arena]()
+            {
+                sink = lazy::pb_decode(pb_data.data(), pb_data.size(), arena)->id;
+                arena.reset();
+            }, times);
+    measure("Lazy Pb (all logs)", [&pb_data, &arena]()
+            {
+                sink = touch_logs(lazy::pb_decode(pb_data.data(), pb_data.size(), arena));
+                arena.reset();
+            }, times);
+
+    measure("Json", [&json_data]()
+            {
+                Person msg;
+                google::protobuf::util::JsonStringToMessage(json_data, &msg);
+            }, times);
+    measure("Codec Json", [&json_data]()
+            {
+                codec::Person person;
+                codec::json_decode(json_data.data(), json_data.size(), person);
+            }, times);
+    measure("Lazy Json (id only)", [&json_data, &arena]()
+            {
+                sink = lazy::json_decode(json_data.data(), json_data.size(), arena)->id;
+                arena.reset();
+            }, times);
+    measure("Lazy Json (all logs)", [&json_data, &arena]()
+            {
+                sink = touch_logs(lazy::json_decode(json_data.data(), json_data.size(), arena));
+                arena.reset();
+            }, times);
+}
+
+// runs `func` in a child process, so the child's ru_maxrss is the
+// peak of that one approach (plus what it inherited from us)
+template<class F>
+void in_child(const char* label, F func)
+{
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        std::cout << std::left << std::setw(18) << label << ": ";
+        func();
+        std::cout.flush();
+        _exit(0);
+    }
+
+    int status;
+    struct rusage usage;
+    if(pid < 0 || wait4(pid, &status, 0, &usage) < 0)
+    {
+        std::cout << "fork failed" << std::endl;
+        exit(1);
+    }
+    std::cout << "Peak RSS: " << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+}
+
+// gzip'd json decoded by inflating everything first,
+// and by streaming inflated chunks into the parser
+void stream_benchmark(int amount, int times)
+{
+    std::string gz;
+    {
+        Pack p(amount);
+        std::string json;
+        p.create_codec_json(json);
+        gz = gzip_compress(json);
+
+        std::cout << "LogAmount = " << amount << std::endl;
+        std::cout << "Json Size         : " << json.size() << std::endl;
+        std::cout << "Json GZip Size    : " << gz.size() << std::endl;
+        std::cout << std::endl;
+    }
+
+    auto report = [times](double seconds, bool ok)
+    {
+        std::cout << std::setw(12) << seconds / times * 1000 << " ms/Msg  "
+                  << (ok ? "" : "FAILED ");
+    };
+
+    std::cout << "Benchmark Times = " << times << std::endl;
+    in_child("Baseline", [&gz]()
+            {
+                std::cout << std::setw(20) << gz.size() << " bytes  ";
+            });
+    in_child("Buffer Then Parse", [&gz, times, &report]()
+            {
+                codec::Person person;
+                bool ok = true;
+                double seconds = timeit([&gz, &person, &ok]()
+                        {
+                            std::string json = gzip_decompress(gz);
+                            ok &= codec::json_decode(json.data(), json.size(), person);
+                        }, times);
+                report(seconds, ok);
+            });
+    in_child("Stream", [&gz, times, &report]()
+            {
+                codec::Person person;
+                bool ok = true;
+                double seconds = timeit([&gz, &person, &ok]()
+                        {
+                            ok &= gunzip_json_stream(gz.data(), gz.size(), person);
+                        }, times);
+                report(seconds, ok);
+            });
+    in_child("Stream 2 Threads", [&gz, times, &report]()
+            {
+                codec::Person person;
+                GunzipPipeline pipeline;
+                bool ok = true;
+                double seconds = timeit([&gz, &person, &pipeline, &ok]()
+                        {
+                            ok &= pipeline.decode(gz.data(), gz.size(), person);
+                        }, times);
+                report(seconds, ok);
+            });
+}
+
+// one benchmark case for the --threads mode. `make` runs on the
+// benchmark thread itself, so every thread gets its own input and
+// output buffers, and returns the function to time there. the function
+// adds whatever it must not let the compiler drop to the thread's own
+// `sum`, not to the shared `sink`.
+struct ThreadCase
+{
+    const char* label;
+    std::function<std::function<void(int64_t& sum)>()> make;
+};
+
+struct ThreadResult
+{
+    double seconds;
+    std::size_t allocs;
+    int64_t sum;
+};
+
+// runs `func` from `make` on `threads` threads at once, every thread
+// starts together and does `times` calls. returns the slowest thread.
+// every thread's sum stays on its own stack while timed, and goes to
+// `sink` once all have finished.
+ThreadResult run_threads(const ThreadCase& c, int threads, int times)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<ThreadResult> results(threads);
+    std::vector<std::thread> workers;
+
+    for(int t=0; t<threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                {
+                    auto func = c.make();
+                    int64_t sum = 0;
+                    func(sum);
+
+                    ready++;
+                    while(!go)
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    std::size_t before = allocations();
+                    results[t].seconds = timeit([&func, &sum]() { func(sum); }, times);
+                    results[t].allocs = allocations() - before;
+                    results[t].sum = sum;
+                });
+    }
+
+    while(ready < threads)
+    {
+        std::this_thread::yield();
+    }
+    go = true;
+    for(auto& w: workers)
+    {
+        w.join();
+    }
+
+    ThreadResult total = {0, 0, 0};
+    for(auto& r: results)
+    {
+        total.seconds = std::max(total.seconds, r.seconds);
+        total.allocs += r.allocs;
+        total.sum += r.sum;
+    }
+    sink = total.sum;
+    return total;
+}
+
+// every case at 1, 2, 4 ... max_threads threads.
+// efficiency is msgs/s against `threads` times the single thread rate,
+// Malloc/Free shows how the allocator alone scales on this machine.
+void thread_benchmark(std::vector<ThreadCase> cases, int max_threads, int times)
+{
+    cases.push_back({"Malloc/Free", []()
+            {
+                return [](int64_t& sum)
+                {
+                    for(int i=0; i<64; i++)
+                    {
+                        void* p = ::operator new(48);
+                        sum += reinterpret_cast<intptr_t>(p);
+                        ::operator delete(p);
+                    }
+                };
+            }});
+
+    std::vector<int> counts;
+    for(int n=1; n<max_threads; n*=2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+
+    std::cout << "Benchmark Times = " << times << " per thread, Cores = "
+              << std::thread::hardware_concurrency() << std::endl;
+
+    for(auto& c: cases)
+    {
+        double single = 0;
+        for(int threads: counts)
+        {
+            ThreadResult r = run_threads(c, threads, times);
+            double rate = threads * static_cast<double>(times) / r.seconds;
+            if(threads == 1)
+            {
+                single = rate;
+            }
+
+            std::cout << std::left << std::setw(18) << c.label << ": "
+                      << std::right << std::setw(3) << threads << " Threads"
+                      << "  Msgs/s: " << std::left << std::setw(12) << rate
+                      << " Efficiency: " << std::setw(8) << rate / (single * threads)
+                      << " Allocs/Msg: " << static_cast<double>(r.allocs) / (threads * times)
+                      << std::endl;
+        }
+    }
+}
+
+void pack_thread_benchmark(int amount, int times, int threads)
+{
+    std::cout << "LogAmount = " << amount << std::endl;
+
+    auto pack = [amount](auto encode)
+    {
+        return [amount, encode]() -> std::function<void(int64_t&)>
+        {
+            auto p = std::make_shared<Pack>(amount);
+            auto buffer = std::make_shared<std::string>();
+            return [p, buffer, encode](int64_t&) { encode(*p, *buffer); };
+        };
+    };
+
+    thread_benchmark({
+            {"Protobuf", pack([](Pack& p, std::string&) { p.create_pb(); })},
+            {"Json", pack([](Pack& p, std::string&) { p.create_json(); })},
+            {"Json GZip", pack([](Pack& p, std::string&) { p.create_json_gzip(); })},
+            {"Codec Pb", pack([](Pack& p, std::string& out) { p.create_codec_pb(out); })},
+            {"Codec Json", pack([](Pack& p, std::string& out) { p.create_codec_json(out); })},
+        }, threads, times);
+}
+
+void unpack_thread_benchmark(int times, int threads)
+{
+    auto unpack = [](auto decode)
+    {
+        return [decode]() -> std::function<void(int64_t&)>
+        {
+            auto p = std::make_shared<UnPack>(project_path());
+            return [p, decode](int64_t&) { codec::Person person; decode(*p, person); };
+        };
+    };
+
+    thread_benchmark({
+            {"Protobuf", unpack([](UnPack& p, codec::Person&) { p.unpack_pb(); })},
+            {"Json", unpack([](UnPack& p, codec::Person&) { p.unpack_json(); })},
+            {"Json GZip", unpack([](UnPack& p, codec::Person&) { p.unpack_json_gzip(); })},
+            {"Codec Pb", unpack([](UnPack& p, codec::Person& out) { p.unpack_codec_pb(out); })},
+            {"Codec Json", unpack([](UnPack& p, codec::Person& out) { p.unpack_codec_json(out); })},
+            {"Lazy Pb", []() -> std::function<void(int64_t&)>
+                {
+                    auto p = std::make_shared<UnPack>(project_path());
+                    auto arena = std::make_shared<Arena>();
+                    return [p, arena](int64_t& sum) { sum += touch_logs(p->unpack_lazy_pb(*arena)); arena->reset(); };
+                }},
+        }, threads, times);
+}
+
+// Pack's shape with `logs` logs, but ids, numbers and log texts vary,
+// so a dictionary can not just remember one message
+codec::Person varied_person(std::mt19937& rng, int logs)
+{
+    codec::Person person;
+    person.id = static_cast<int32_t>(rng() % 1000000);
+    person.name = "My Playground!!!";
+    person.tags = Pack::get_tags();
+    for(int i=0; i<logs; i++)
+    {
+        int32_t id = static_cast<int32_t>(rng() % 100000);
+        person.logs.push_back(codec::Log{id, "Log Contents..." + std::to_string(id),
+                static_cast<int32_t>(rng() % 2), static_cast<int32_t>(10000000 + rng() % 1000000)});
+    }
+    return person;
+}
+
+std::string encode_person(const codec::Person& person, bool json)
+{
+    std::string out(json ? codec::json_size(person) : codec::pb_size(person), '\0');
+    char* end = json ? codec::json_encode(person, &out[0]) : codec::pb_encode(person, &out[0]);
+    out.resize(end - out.data());
+    return out;
+}
+
+// trained on 1000 messages of 0-10 logs, the sizes gzip does worst on
+std::string person_dictionary(bool json)
+{
+    std::mt19937 rng(1);
+    std::vector<std::string> samples;
+    for(int i=0; i<1000; i++)
+    {
+        samples.push_back(encode_person(varied_person(rng, rng() % 11), json));
+    }
+    return train_dictionary(samples);
+}
+
+// per message gzip level 6 against the shared dictionary, on messages
+// the dictionary was not trained on
+void dict_benchmark(int times)
+{
+    for(bool json: {false, true})
+    {
+        auto start = std::chrono::steady_clock::now();
+        DictCompressor dict(person_dictionary(json));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << (json ? "Json" : "Protobuf") << " Dictionary = " << dict.dictionary().size()
+                  << " bytes, trained in " << elapsed.count() << " s" << std::endl;
+
+        std::mt19937 rng(2);
+        for(int logs: {0, 1, 2, 5, 10, 50, 100})
+        {
+            std::vector<std::string> messages;
+            for(int i=0; i<100; i++)
+            {
+                messages.push_back(encode_person(varied_person(rng, logs), json));
+            }
+
+            std::size_t raw = 0, gzip = 0, shared = 0;
+            std::string packed, unpacked;
+            for(auto& m: messages)
+            {
+                raw += m.size();
+                gzip += gzip_compress(m).size();
+                dict.compress(m.data(), m.size(), packed);
+                shared += packed.size();
+                if(!dict.decompress(packed.data(), packed.size(), unpacked) || unpacked != m)
+                {
+                    std::cout << "dictionary round trip failed" << std::endl;
+                    exit(1);
+                }
+            }
+
+            std::vector<std::string> gzipped, dicted;
+            for(auto& m: messages)
+            {
+                gzipped.push_back(gzip_compress(m));
+                dict.compress(m.data(), m.size(), packed);
+                dicted.push_back(packed);
+            }
+
+            // microseconds per message
+            double per = 1e6 / (static_cast<double>(times) * messages.size());
+            double gzip_pack = timeit([&messages]() { for(auto& m: messages) gzip_compress(m); }, times) * per;
+            double gzip_unpack = timeit([&gzipped]() { for(auto& m: gzipped) gzip_decompress(m); }, times) * per;
+            double dict_pack = timeit([&messages, &dict, &packed]()
+                    {
+                        for(auto& m: messages) dict.compress(m.data(), m.size(), packed);
+                    }, times) * per;
+            double dict_unpack = timeit([&dicted, &dict, &unpacked]()
+                    {
+                        for(auto& m: dicted) dict.decompress(m.data(), m.size(), unpacked);
+                    }, times) * per;
+
+            double n = static_cast<double>(messages.size());
+            std::cout << "Logs " << std::left << std::setw(4) << logs
+                      << " Size: " << std::setw(7) << raw / n
+                      << " GZip: " << std::setw(7) << gzip / n
+                      << " Dict: " << std::setw(7) << shared / n
+                      << " GZip us: " << std::setw(7) << gzip_pack << "/ " << std::setw(7) << gzip_unpack
+                      << " Dict us: " << dict_pack << " / " << dict_unpack << std::endl;
+        }
+        std::cout << std::endl;
+    }
+}
+
+// pack/unpack with warmup and repeated samples, written to `path`
+// for report.py. pack uses 100 logs, like the data.* fixtures.
+void harness_benchmark(int samples, const std::string& path)
+{
+    harness::Options options;
+    options.samples = samples;
+
+    DictCompressor pb_dict(person_dictionary(false));
+    DictCompressor json_dict(person_dictionary(true));
+
+    std::vector<harness::SizeRow> sizes;
+    for(int logs: {0, 10, 50, 100})
+    {
+        Pack p(logs);
+        std::string buffer;
+        std::string pb = p.create_pb();
+        std::string json = p.create_json();
+        std::string pb_packed, json_packed;
+        pb_dict.compress(pb.data(), pb.size(), pb_packed);
+        json_dict.compress(json.data(), json.size(), json_packed);
+
+        harness::SizeRow row;
+        row.logs = logs;
+        row.sizes = {
+            {"Protobuf", pb.size()},
+            {"Protobuf GZip", gzip_compress(pb).size()},
+            {"Protobuf Dict", pb_packed.size()},
+            {"Json", json.size()},
+            {"Json GZip", p.create_json_gzip().size()},
+            {"Json Dict", json_packed.size()},
+            {"Codec Pb", p.create_codec_pb(buffer)},
+            {"Codec Json", p.create_codec_json(buffer)},
+            {"Flat", p.create_flat(buffer)},
+        };
+        sizes.push_back(row);
+    }
+
+    PerfCounters perf;
+    std::vector<harness::Result> results;
+    auto run = [&](const char* group, const char* name, auto func)
+    {
+        results.push_back(harness::run(group, name, func, options, perf));
+        auto& r = results.back();
+
+        std::cout << std::left << std::setw(7) << group << std::setw(11) << name << ": "
+                  << std::setw(10) << r.ns.median << " ns/op  95% CI [" << r.ns.ci_low << ", " << r.ns.ci_high
+                  << "]  p95 " << r.ns.p95 << "  Allocs/Op: " << r.allocs_per_call
+                  << "  Bytes/Op: " << r.bytes_per_call << std::endl;
+    };
+
+    std::cout << "Samples = " << samples << ", Perf Counters: " << (perf.available() ? "on" : "off") << std::endl;
+
+    Pack pack(100);
+    std::string buffer;
+    run("pack", "Protobuf", [&pack]() { pack.create_pb(); });
+    run("pack", "Json", [&pack]() { pack.create_json(); });
+    run("pack", "Json GZip", [&pack]() { pack.create_json_gzip(); });
+    run("pack", "Codec Pb", [&pack, &buffer]() { pack.create_codec_pb(buffer); });
+    run("pack", "Codec Json", [&pack, &buffer]() { pack.create_codec_json(buffer); });
+    run("pack", "Flat", [&pack, &buffer]() { pack.create_flat(buffer); });
+    std::string packed;
+    run("pack", "Pb Dict", [&pack, &buffer, &pb_dict, &packed]()
+            {
+                pack.create_codec_pb(buffer);
+                pb_dict.compress(buffer.data(), buffer.size(), packed);
+            });
+
+    UnPack unpack(project_path());
+    simd_json::Parser parser;
+    Arena arena;
+    run("unpack", "Protobuf", [&unpack]() { unpack.unpack_pb(); });
+    run("unpack", "Json", [&unpack]() { unpack.unpack_json(); });
+    run("unpack", "Json GZip", [&unpack]() { unpack.unpack_json_gzip(); });
+    run("unpack", "Codec Pb", [&unpack]() { codec::Person person; unpack.unpack_codec_pb(person); });
+    run("unpack", "Codec Json", [&unpack]() { codec::Person person; unpack.unpack_codec_json(person); });
+    run("unpack", "Simd Json", [&unpack, &parser]() { codec::Person person; unpack.unpack_simd_json(parser, person); });
+    run("unpack", "Lazy Pb", [&unpack, &arena]() { sink = touch_logs(unpack.unpack_lazy_pb(arena)); arena.reset(); });
+    run("unpack", "Lazy Json", [&unpack, &arena]() { sink = touch_logs(unpack.unpack_lazy_json(arena)); arena.reset(); });
+    run("unpack", "Stream Gz", [&unpack]() { codec::Person person; unpack.unpack_stream_json_gzip(person); });
+    run("unpack", "Flat", [&unpack]() { sink = touch_logs(unpack.unpack_flat(false)); });
+    run("unpack", "Flat Check", [&unpack]() { sink = touch_logs(unpack.unpack_flat(true)); });
+    pb_dict.compress(unpack.data_pb().data(), unpack.data_pb().size(), packed);
+    run("unpack", "Pb Dict", [&pb_dict, &packed, &buffer]()
+            {
+                codec::Person person;
+                pb_dict.decompress(packed.data(), packed.size(), buffer);
+                codec::pb_decode(buffer.data(), buffer.size(), person);
+            });
+
+    std::ofstream out(path);
+    harness::write_json(out, "Cpp", options, sizes, results);
+    if(!out)
+    {
+        std::cout << "can not write " << path << std::endl;
+        exit(1);
+    }
+    std::cout << "Results: " << path << std::endl;
+}
+
+// packed int32 arrays from 20 to 1M values: the byte at a time loop
+// the codec used before, against varint_batch.h with every kernel.
+// each case handles `millions` million values in total.
+void varint_benchmark(int millions)
+{
+    struct Distribution
+    {
+        const char* name;
+        int32_t (*value)(int);
+    };
+    const Distribution distributions[] = {
+        {"1 byte", [](int i) { return i % 100; }},
+        {"1-3 bytes", [](int i) { return static_cast<int32_t>(i * 7919LL % 2000000); }},
+    };
+
+    auto best = varint::detect_kernel();
+    for(int n: {20, 1000, 100000, 1000000})
+    {
+        for(auto& d: distributions)
+        {
+            std::vector<int32_t> tags(n);
+            for(int i=0; i<n; i++)
+            {
+                tags[i] = d.value(i);
+            }
+
+            std::string packed(varint::encoded_size_int32(tags.data(), n), '\0');
+            varint::set_kernel(varint::SCALAR);
+            varint::encode_int32(tags.data(), n, &packed[0]);
+
+            int times = std::max<int64_t>(1, millions * 1000000LL / n);
+            double values = static_cast<double>(n) * times;
+            auto rate = [values](double seconds)
+            {
+                return values / seconds / 1e6;
+            };
+
+            std::cout << "Tags = " << n << " (" << d.name << "), Packed Size = " << packed.size()
+                      << ", Benchmark Times = " << times << std::endl;
+
+            std::vector<int32_t> out;
+            out.reserve(n);
+            std::cout << "Loop Decode M/s   : " << rate(timeit([&packed, &out]()
+                    {
+                        out.clear();
+                        const char* p = packed.data();
+                        const char* end = p + packed.size();
+                        while(p < end)
+                        {
+                            uint64_t v = 0;
+                            codec::read_varint(p, end, v);
+                            out.push_back(static_cast<int32_t>(v));
+                        }
+                    }, times)) << std::endl;
+
+            std::string buffer(packed.size(), '\0');
+            std::cout << "Loop Encode M/s   : " << rate(timeit([&tags, &buffer]()
+                    {
+                        char* p = &buffer[0];
+                        for(auto v: tags)
+                        {
+                            p = codec::write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(v)));
+                        }
+                    }, times)) << std::endl;
+
+            for(int k=varint::SCALAR; k<=best; k++)
+            {
+                auto kernel = static_cast<varint::Kernel>(k);
+                varint::set_kernel(kernel);
+                std::string name = varint::kernel_name(kernel);
+                name.resize(6, ' ');
+
+                std::cout << "Batch " << name << " Decode: " << rate(timeit([&packed, &out]()
+                        {
+                            out.clear();
+                            varint::append_int32(packed.data(), packed.data() + packed.size(), out);
+                        }, times));
+                bool same = out == tags;
+
+                std::cout << "  Encode: " << rate(timeit([&tags, &buffer]()
+                        {
+                            varint::encode_int32(tags.data(), tags.size(), &buffer[0]);
+                        }, times));
+                same = same && buffer == packed;
+                std::cout << (same ? "" : "  MISMATCH") << std::endl;
+            }
+            std::cout << std::endl;
+        }
+    }
+    varint::set_kernel(best);
+}
+
+// data.flat, the flat_person.h fixture, from the same 100 logs
+void write_flat()
+{
+    std::string data;
+    Pack(100).create_flat(data);
+
+    std::string path = project_path() + "/data.flat";
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+    if(!out)
+    {
+        std::cout << "can not write " << path << std::endl;
+        exit(1);
+    }
+    std::cout << "Flat Size         : " << data.size() << " -> " << path << std::endl;
+}
+
+// records.pb / records.ndjson live next to the executable, they are
+// too big for the repo
+std::string records_path(records::Format f)
+{
+    return project_path() + (f == records::PROTOBUF ? "/Cpp/records.pb" : "/Cpp/records.ndjson");
+}
+
+void write_records(int count, int amount)
+{
+    codec::Person person;
+    person.id = 1;
+    person.name = "My Playground!!!";
+    person.tags = Pack::get_tags();
+    person.logs = Pack::get_logs(amount);
+
+    for(auto f: {records::PROTOBUF, records::NDJSON})
+    {
+        std::string path = records_path(f);
+        auto start = std::chrono::steady_clock::now();
+        if(!records::write_file(path, f, count, person))
+        {
+            std::cout << "can not write " << path << std::endl;
+            exit(1);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        std::cout << std::left << std::setw(18) << records::format_name(f) << ": "
+                  << static_cast<double>(in.tellg()) / 1e9 << " GB in " << elapsed.count()
+                  << " s -> " << path << std::endl;
+    }
+}
+
+// decodes both record files on 1, 2, 4 ... `max_threads` threads.
+// the first pass reads from disk unless the files are still in the page cache.
+void records_benchmark(int max_threads)
+{
+    std::vector<int> counts;
+    for(int n=1; n<max_threads; n*=2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(max_threads);
+
+    std::cout << "Cores = " << std::thread::hardware_concurrency() << std::endl;
+    for(auto f: {records::PROTOBUF, records::NDJSON})
+    {
+        MappedFile file(records_path(f));
+        double gb = static_cast<double>(file.size()) / 1e9;
+        std::cout << std::left << std::setw(18) << records::format_name(f) << ": "
+                  << gb << " GB" << std::endl;
+
+        for(int threads: counts)
+        {
+            auto start = std::chrono::steady_clock::now();
+            records::Stats stats = records::decode_file(file, f, threads);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            double seconds = elapsed.count();
+            sink = stats.checksum;
+
+            std::cout << std::left << std::setw(18) << records::format_name(f) << ": "
+                      << std::right << std::setw(3) << threads << " Threads"
+                      << "  GB/s: " << std::left << std::setw(10) << gb / seconds
+                      << " Records/s: " << std::setw(12) << stats.records / seconds
+                      << " Records: " << stats.records
+                      << " Errors: " << stats.errors << std::endl;
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    // --threads N runs pack/unpack on 1 to N threads at once
+    int threads = 0;
+    for(int i=1; i<argc; i++)
+    {
+        if(std::string(argv[i]) != "--threads") continue;
+        if(i + 1 >= argc) usage();
+
+        std::string n = argv[i + 1];
+        threads = n == "all" ? static_cast<int>(std::thread::hardware_concurrency()) : to_int(n.c_str());
+        if(threads <= 0) usage();
+
+        for(int j=i; j+2<argc; j++)
+        {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        break;
+    }
+
+    std::string cmd = argc > 1 ? argv[1] : "";
+
+    if(cmd == "pack" && argc == 4)
+    {
+        int amount = to_int(argv[2]);
+        int times = to_int(argv[3]);
+        if(amount < 0 || times <= 0) usage();
+
+        if(threads) pack_thread_benchmark(amount, times, threads);
+        else pack_benchmark(amount, times);
+    }
+    else if(cmd == "unpack" && argc == 3)
+    {
+        int times = to_int(argv[2]);
+        if(times <= 0) usage();
+
+        if(threads) unpack_thread_benchmark(times, threads);
+        else unpack_benchmark(times);
+    }
+    else if(cmd == "simd" && argc == 3)
+    {
+        int times = to_int(argv[2]);
+        if(times <= 0) usage();
+
+        simd_benchmark(times);
+    }
+    else if(cmd == "lazy" && argc == 4)
+    {
+        int amount = to_int(argv[2]);
+        int times = to_int(argv[3]);
+        if(amount < 0 || times <= 0) usage();
+
+        lazy_benchmark(amount, times);
+    }
+    else if(cmd == "stream" && argc == 4)
+    {
+        int amount = to_int(argv[2]);
+        int times = to_int(argv[3]);
+        if(amount < 0 || times <= 0) usage();
+
+        stream_benchmark(amount, times);
+    }
+    else if(cmd == "harness" && argc == 4)
+    {
+        int samples = to_int(argv[2]);
+        if(samples <= 1) usage();
+
+        harness_benchmark(samples, argv[3]);
+    }
+    else if(cmd == "varint" && argc == 3)
+    {
+        int millions = to_int(argv[2]);
+        if(millions <= 0) usage();
+
+        varint_benchmark(millions);
+    }
+    else if(cmd == "dict" && argc == 3)
+    {
+        int times = to_int(argv[2]);
+        if(times <= 0) usage();
+
+        dict_benchmark(times);
+    }
+    else if(cmd == "write-flat" && argc == 2)
+    {
+        write_flat();
+    }
+    else if(cmd == "write-records" && argc == 4)
+    {
+        int count = to_int(argv[2]);
+        int amount = to_int(argv[3]);
+        if(count <= 0 || amount < 0) usage();
+
+        write_records(count, amount);
+    }
+    else if(cmd == "records" && argc == 3)
+    {
+        int max_threads = to_int(argv[2]);
+        if(max_threads <= 0) usage();
+
+        records_benchmark(max_threads);
+    }
+    else
+    {
+        usage();
+    }
+
+    return 0;
+}
@@ -0,0 +1,662 @@
+#ifndef __CODEC_RUNTIME_H__
+#define __CODEC_RUNTIME_H__
+
+// helpers used by the code gen_codec.py generates.
+// everything here is inline: the generated encode/decode routines
+// should compile down to straight-line code for a fixed schema.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#define CODEC_INLINE inline __attribute__((always_inline))
+
+namespace codec
+{
+
+enum WireType : uint32_t
+{
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LENGTH = 2,
+    WIRE_FIXED32 = 5,
+};
+
+constexpr uint32_t make_tag(uint32_t number, WireType wire)
+{
+    return (number << 3) | wire;
+}
+
+constexpr std::size_t varint_size_const(uint64_t v)
+{
+    return v < 0x80 ? 1 : 1 + varint_size_const(v >> 7);
+}
+
+struct FieldInfo
+{
+    uint32_t number;
+    WireType wire;
+    bool repeated;
+    bool packed;
+    // key on the wire, and its encoded size
+    uint32_t tag;
+    std::size_t tag_size;
+    // json member name, and the `"name":` prefix written by the encoder
+    std::string_view name;
+    std::string_view json_key;
+};
+
+constexpr FieldInfo make_field(uint32_t number, WireType wire, bool repeated, bool packed,
+        std::string_view name, std::string_view json_key)
+{
+    return FieldInfo{number, packed ? WIRE_LENGTH : wire, repeated, packed,
+            make_tag(number, packed ? WIRE_LENGTH : wire),
+            varint_size_const(make_tag(number, packed ? WIRE_LENGTH : wire)),
+            name, json_key};
+}
+
+
+// ---- protobuf wire format ----
+
+CODEC_INLINE std::size_t varint_size(uint64_t v)
+{
+    // ceil(bits / 7) without a loop
+    int bits = 64 - __builtin_clzll(v | 1);
+    return (bits * 9 + 64) / 64;
+}
+
+CODEC_INLINE char* write_varint(char* p, uint64_t v)
+{
+    while(v >= 0x80)
+    {
+        *p++ = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast<char>(v);
+    return p;
+}
+
+inline bool read_varint_slow(const char*& p, const char* end, uint64_t& v)
+{
+    uint64_t result = 0;
+    for(int shift=0; shift<64; shift+=7)
+    {
+        if(p >= end) return false;
+
+        uint8_t b = static_cast<uint8_t>(*p++);
+        result |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if(b < 0x80)
+        {
+            v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+CODEC_INLINE bool read_varint(const char*& p, const char* end, uint64_t& v)
+{
+    // most values in this schema fit in one byte
+    if(p < end && static_cast<uint8_t>(*p) < 0x80)
+    {
+        v = static_cast<uint8_t>(*p++);
+        return true;
+    }
+    return read_varint_slow(p, end, v);
+}
+
+inline bool skip_field(const char*& p, const char* end, uint32_t wire)
+{
+    uint64_t v;
+    switch(wire)
+    {
+    case WIRE_VARINT:
+        return read_varint(p, end, v);
+    case WIRE_FIXED64:
+        if(end - p < 8) return false;
+        p += 8;
+        return true;
+    case WIRE_LENGTH:
+        if(!read_varint(p, end, v) || v > static_cast<uint64_t>(end - p)) return false;
+        p += v;
+        return true;
+    case WIRE_FIXED32:
+        if(end - p < 4) return false;
+        p += 4;
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+// ---- json ----
+
+struct EscapeTable
+{
+    // encoded length of each byte inside a json string
+    uint8_t size[256];
+
+    constexpr EscapeTable(): size()
+    {
+        for(int c=0; c<256; c++)
+        {
+            if(c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t')
+            {
+                size[c] = 2;
+            }
+            else if(c < 0x20)
+            {
+                size[c] = 6;
+            }
+            else
+            {
+                size[c] = 1;
+            }
+        }
+    }
+};
+
+inline constexpr EscapeTable escape_table{};
+
+struct DigitTable
+{
+    char pairs[200];
+
+    constexpr DigitTable(): pairs()
+    {
+        for(int i=0; i<100; i++)
+        {
+            pairs[i * 2] = static_cast<char>('0' + i / 10);
+            pairs[i * 2 + 1] = static_cast<char>('0' + i % 10);
+        }
+    }
+};
+
+inline constexpr DigitTable digit_table{};
+
+inline constexpr uint64_t pow10_table[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+CODEC_INLINE std::size_t decimal_size(uint64_t v)
+{
+    v |= 1;
+    int bits = 64 - __builtin_clzll(v);
+    int t = (bits * 1233) >> 12;
+    return t - (v < pow10_table[t]) + 1;
+}
+
+CODEC_INLINE std::size_t decimal_size(int64_t v)
+{
+    return v < 0 ? 1 + decimal_size(0 - static_cast<uint64_t>(v)) : decimal_size(static_cast<uint64_t>(v));
+}
+
+CODEC_INLINE char* write_decimal(char* p, uint64_t v)
+{
+    std::size_t n = decimal_size(v);
+    char* q = p + n;
+    while(v >= 100)
+    {
+        auto i = (v % 100) * 2;
+        v /= 100;
+        *--q = digit_table.pairs[i + 1];
+        *--q = digit_table.pairs[i];
+    }
+    if(v >= 10)
+    {
+        *--q = digit_table.pairs[v * 2 + 1];
+        *--q = digit_table.pairs[v * 2];
+    }
+    else
+    {
+        *--q = static_cast<char>('0' + v);
+    }
+    return p + n;
+}
+
+CODEC_INLINE char* write_decimal(char* p, int64_t v)
+{
+    if(v < 0)
+    {
+        *p++ = '-';
+        return write_decimal(p, 0 - static_cast<uint64_t>(v));
+    }
+    return write_decimal(p, static_cast<uint64_t>(v));
+}
+
+CODEC_INLINE char* write_raw(char* p, std::string_view s)
+{
+    std::memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+CODEC_INLINE std::size_t json_string_size(std::string_view s)
+{
+    std::size_t n = 2;
+    for(unsigned char c: s)
+    {
+        n += escape_table.size[c];
+    }
+    return n;
+}
+
+inline char* write_json_string(char* p, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    *p++ = '"';
+    const char* run = s.data();
+    const char* end = s.data() + s.size();
+    for(const char* c=run; c<end; c++)
+    {
+        unsigned char ch = static_cast<unsigned char>(*c);
+        if(escape_table.size[ch] == 1) continue;
+
+        std::memcpy(p, run, c - run);
+        p += c - run;
+        run = c + 1;
+
+        *p++ = '\\';
+        switch(ch)
+        {
+        case '"': *p++ = '"'; break;
+        case '\\': *p++ = '\\'; break;
+        case '\b': *p++ = 'b'; break;
+        case '\f': *p++ = 'f'; break;
+        case '\n': *p++ = 'n'; break;
+        case '\r': *p++ = 'r'; break;
+        case '\t': *p++ = 't'; break;
+        default:
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[ch >> 4];
+            *p++ = hex[ch & 0xf];
+        }
+    }
+    std::memcpy(p, run, end - run);
+    p += end - run;
+    *p++ = '"';
+    return p;
+}
+
+
+// json integer at `p`, a fraction or exponent is an error
+// since all our numeric fields are integers
+template<class T>
+inline bool parse_integer(const char*& p, const char* end, T& v)
+{
+    bool negative = false;
+    if(p < end && *p == '-')
+    {
+        if(!std::numeric_limits<T>::is_signed) return false;
+        negative = true;
+        p++;
+    }
+
+    const char* start = p;
+    uint64_t r = 0;
+    while(p < end && static_cast<unsigned>(*p - '0') < 10)
+    {
+        uint64_t d = *p - '0';
+        if(r > (std::numeric_limits<uint64_t>::max() - d) / 10) return false;
+        r = r * 10 + d;
+        p++;
+    }
+    if(p == start) return false;
+    if(p < end && (*p == '.' || *p == 'e' || *p == 'E')) return false;
+
+    if(negative)
+    {
+        if(r > static_cast<uint64_t>(std::numeric_limits<T>::max()) + 1) return false;
+        v = static_cast<T>(0 - r);
+    }
+    else
+    {
+        if(r > static_cast<uint64_t>(std::numeric_limits<T>::max())) return false;
+        v = static_cast<T>(r);
+    }
+    return true;
+}
+
+
+// pull parser over a complete json text.
+// the generated decoders drive it directly, no DOM is built;
+// any class with the same public methods can drive them too.
+class JsonReader
+{
+public:
+    JsonReader(const char* p, const char* end):
+        p_(p), end_(end), error_(false)
+    {}
+
+    bool ok() const
+    {
+        return !error_;
+    }
+
+    bool at_end()
+    {
+        skip_ws();
+        return !error_ && p_ == end_;
+    }
+
+    bool begin_object()
+    {
+        return expect('{');
+    }
+
+    // true and consumes `}` if the object is empty
+    bool end_object()
+    {
+        return accept('}');
+    }
+
+    // after a member: true on `,`, false on `}` or error
+    bool next_member()
+    {
+        return next(',', '}');
+    }
+
+    bool begin_array()
+    {
+        return expect('[');
+    }
+
+    bool end_array()
+    {
+        return accept(']');
+    }
+
+    bool next_element()
+    {
+        return next(',', ']');
+    }
+
+    // member name and the following `:`,
+    // the view points into the input unless the name has escapes
+    bool read_key(std::string_view& key)
+    {
+        return read_string_view(key) && expect(':');
+    }
+
+    bool read_null()
+    {
+        skip_ws();
+        if(end_ - p_ >= 4 && std::memcmp(p_, "null", 4) == 0)
+        {
+            p_ += 4;
+            return true;
+        }
+        return false;
+    }
+
+    bool read_bool(bool& v)
+    {
+        skip_ws();
+        if(end_ - p_ >= 4 && std::memcmp(p_, "true", 4) == 0)
+        {
+            p_ += 4;
+            v = true;
+            return true;
+        }
+        if(end_ - p_ >= 5 && std::memcmp(p_, "false", 5) == 0)
+        {
+            p_ += 5;
+            v = false;
+            return true;
+        }
+        return fail();
+    }
+
+    template<class T>
+    bool read_integer(T& v)
+    {
+        skip_ws();
+        return parse_integer(p_, end_, v) || fail();
+    }
+
+    bool read_string(std::string& out)
+    {
+        std::string_view v;
+        if(!read_string_view(v)) return false;
+        out.assign(v.data(), v.size());
+        return true;
+    }
+
+    bool read_string_view(std::string_view& out)
+    {
+        if(!expect('"')) return false;
+
+        const char* start = p_;
+        while(p_ < end_ && *p_ != '"' && *p_ != '\\')
+        {
+            p_++;
+        }
+        if(p_ >= end_) return fail();
+
+        if(*p_ == '"')
+        {
+            out = std::string_view(start, p_ - start);
+            p_++;
+            return true;
+        }
+
+        scratch_.assign(start, p_ - start);
+        if(!unescape(scratch_)) return false;
+        out = scratch_;
+        return true;
+    }
+
+    bool skip_value()
+    {
+        skip_ws();
+        if(p_ >= end_) return fail();
+
+        std::string_view s;
+        switch(*p_)
+        {
+        case '"':
+            return read_string_view(s);
+        case '{':
+            p_++;
+            if(end_object()) return true;
+            do
+            {
+                if(!read_key(s) || !skip_value()) return false;
+            } while(next_member());
+            return ok();
+        case '[':
+            p_++;
+            if(end_array()) return true;
+            do
+            {
+                if(!skip_value()) return false;
+            } while(next_element());
+            return ok();
+        case 't':
+        case 'f':
+            bool b;
+            return read_bool(b);
+        case 'n':
+            return read_null() || fail();
+        default:
+            return skip_number();
+        }
+    }
+
+    const char* position() const
+    {
+        return p_;
+    }
+
+private:
+    void skip_ws()
+    {
+        while(p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+        {
+            p_++;
+        }
+    }
+
+    bool fail()
+    {
+        error_ = true;
+        return false;
+    }
+
+    bool expect(char c)
+    {
+        skip_ws();
+        if(p_ < end_ && *p_ == c)
+        {
+            p_++;
+            return true;
+        }
+        return fail();
+    }
+
+    bool accept(char c)
+    {
+        skip_ws();
+        if(p_ < end_ && *p_ == c)
+        {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool next(char more, char close)
+    {
+        skip_ws();
+        if(p_ < end_ && *p_ == more)
+        {
+            p_++;
+            return true;
+        }
+        if(p_ < end_ && *p_ == close)
+        {
+            p_++;
+            return false;
+        }
+        return fail();
+    }
+
+    bool skip_number()
+    {
+        const char* start = p_;
+        while(p_ < end_ && (static_cast<unsigned>(*p_ - '0') < 10 || *p_ == '-' || *p_ == '+'
+                || *p_ == '.' || *p_ == 'e' || *p_ == 'E'))
+        {
+            p_++;
+        }
+        return p_ != start || fail();
+    }
+
+    static void append_utf8(std::string& out, uint32_t cp)
+    {
+        if(cp < 0x80)
+        {
+            out += static_cast<char>(cp);
+        }
+        else if(cp < 0x800)
+        {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else if(cp < 0x10000)
+        {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
+    bool read_hex4(uint32_t& v)
+    {
+        if(end_ - p_ < 4) return fail();
+
+        v = 0;
+        for(int i=0; i<4; i++)
+        {
+            char c = *p_++;
+            v <<= 4;
+            if(c >= '0' && c <= '9') v |= c - '0';
+            else if(c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else return fail();
+        }
+        return true;
+    }
+
+    // p_ is at the first backslash, out holds the text before it
+    bool unescape(std::string& out)
+    {
+        while(p_ < end_)
+        {
+            char c = *p_++;
+            if(c == '"') return true;
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if(p_ >= end_) return fail();
+            c = *p_++;
+            switch(c)
+            {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+                {
+                    uint32_t cp;
+                    if(!read_hex4(cp)) return false;
+                    if(cp >= 0xd800 && cp < 0xdc00)
+                    {
+                        uint32_t low;
+                        if(end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') return fail();
+                        p_ += 2;
+                        if(!read_hex4(low) || low < 0xdc00 || low >= 0xe000) return fail();
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(out, cp);
+                }
+                break;
+            default:
+                return fail();
+            }
+        }
+        return fail();
+    }
+
+    const char* p_;
+    const char* end_;
+    bool error_;
+    std::string scratch_;
+};
+
+}
+
+#endif // __CODEC_RUNTIME_H__
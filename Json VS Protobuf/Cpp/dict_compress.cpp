@@ -0,0 +1,209 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include "dict_compress.h"
+
+
+namespace
+{
+
+const std::size_t DMER = 6;
+
+// smallest raw deflate window that holds the whole dictionary
+// plus zlib's lookahead
+int window_bits(std::size_t dictionary_size)
+{
+    int bits = 9;
+    while(bits < 15 && (static_cast<std::size_t>(1) << bits) < dictionary_size + 262)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+}
+
+
+std::string train_dictionary(const std::vector<std::string>& samples, std::size_t size, std::size_t segment)
+{
+    // every 6 byte substring gets an id, `freq` counts the samples it is in
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<uint32_t> freq;
+    // per sample, the dmer id at each position
+    std::vector<std::vector<uint32_t>> dmers(samples.size());
+
+    for(std::size_t s=0; s<samples.size(); s++)
+    {
+        auto& text = samples[s];
+        if(text.size() < DMER) continue;
+
+        std::unordered_map<uint32_t, bool> seen;
+        for(std::size_t i=0; i+DMER<=text.size(); i++)
+        {
+            auto it = ids.emplace(text.substr(i, DMER), static_cast<uint32_t>(freq.size())).first;
+            if(it->second == freq.size())
+            {
+                freq.push_back(0);
+            }
+            dmers[s].push_back(it->second);
+            if(!seen[it->second])
+            {
+                seen[it->second] = true;
+                freq[it->second]++;
+            }
+        }
+    }
+
+    // a dmer in one sample only is not worth the space
+    for(auto& f: freq)
+    {
+        if(f < 2) f = 0;
+    }
+
+    std::vector<std::string> picked;
+    std::size_t total = 0;
+    while(total < size)
+    {
+        uint64_t best_score = 0;
+        std::size_t best_sample = 0;
+        std::size_t best_at = 0;
+
+        for(std::size_t s=0; s<samples.size(); s++)
+        {
+            auto& ds = dmers[s];
+            if(ds.empty()) continue;
+
+            // windows of `segment` bytes hold `span` dmers, scored with a running sum
+            std::size_t span = segment > DMER ? segment - DMER + 1 : 1;
+            span = std::min(span, ds.size());
+
+            uint64_t score = 0;
+            for(std::size_t i=0; i<span; i++)
+            {
+                score += freq[ds[i]];
+            }
+            for(std::size_t at=0; ; at++)
+            {
+                if(score > best_score)
+                {
+                    best_score = score;
+                    best_sample = s;
+                    best_at = at;
+                }
+                if(at + span >= ds.size()) break;
+                score += freq[ds[at + span]];
+                score -= freq[ds[at]];
+            }
+        }
+        if(best_score == 0) break;
+
+        auto& text = samples[best_sample];
+        std::size_t length = std::min(segment, text.size() - best_at);
+        picked.push_back(text.substr(best_at, length));
+        total += length;
+
+        // covered now, later segments only score for new substrings
+        auto& ds = dmers[best_sample];
+        for(std::size_t i=best_at; i<best_at+length && i<ds.size(); i++)
+        {
+            freq[ds[i]] = 0;
+        }
+    }
+
+    // best segment last
+    std::string dictionary;
+    for(auto it=picked.rbegin(); it!=picked.rend(); ++it)
+    {
+        dictionary += *it;
+    }
+    if(dictionary.size() > size)
+    {
+        dictionary.erase(0, dictionary.size() - size);
+    }
+    return dictionary;
+}
+
+
+DictCompressor::DictCompressor(const std::string& dictionary, int level):
+    dictionary_(dictionary), primed_(), inflate_()
+{
+    // negative window bits: raw deflate. memLevel 4 keeps the
+    // hash table, which is copied for every message, at 4KB
+    int bits = window_bits(dictionary_.size());
+    if(deflateInit2(&primed_, level, Z_DEFLATED, -bits, 4, Z_DEFAULT_STRATEGY) != Z_OK
+            || inflateInit2(&inflate_, -bits) != Z_OK)
+    {
+        std::cout << "zlib init failed" << std::endl;
+        exit(1);
+    }
+    if(!dictionary_.empty())
+    {
+        deflateSetDictionary(&primed_, reinterpret_cast<const Bytef*>(dictionary_.data()), dictionary_.size());
+    }
+}
+
+DictCompressor::~DictCompressor()
+{
+    deflateEnd(&primed_);
+    inflateEnd(&inflate_);
+}
+
+void DictCompressor::compress(const char* data, std::size_t size, std::string& out)
+{
+    // setting the dictionary hashes all of it, copying the state
+    // of a stream that has it already is about twice as fast
+    z_stream zs;
+    if(deflateCopy(&zs, &primed_) != Z_OK)
+    {
+        std::cout << "deflateCopy failed" << std::endl;
+        exit(1);
+    }
+
+    out.resize(deflateBound(&zs, size));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = size;
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+
+    if(deflate(&zs, Z_FINISH) != Z_STREAM_END)
+    {
+        std::cout << "deflate failed" << std::endl;
+        exit(1);
+    }
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+}
+
+bool DictCompressor::decompress(const char* data, std::size_t size, std::string& out)
+{
+    inflateReset(&inflate_);
+    if(!dictionary_.empty()
+            && inflateSetDictionary(&inflate_, reinterpret_cast<const Bytef*>(dictionary_.data()), dictionary_.size()) != Z_OK)
+    {
+        return false;
+    }
+
+    inflate_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    inflate_.avail_in = size;
+
+    out.resize(std::max(out.capacity(), size * 4 + 256));
+    std::size_t done = 0;
+    for(;;)
+    {
+        inflate_.next_out = reinterpret_cast<Bytef*>(&out[done]);
+        inflate_.avail_out = out.size() - done;
+
+        int ret = inflate(&inflate_, Z_FINISH);
+        done = out.size() - inflate_.avail_out;
+        if(ret == Z_STREAM_END) break;
+        // out of room, anything else is a broken stream
+        if(ret != Z_BUF_ERROR || inflate_.avail_out != 0) return false;
+
+        out.resize(out.size() * 2);
+    }
+    out.resize(done);
+    return true;
+}
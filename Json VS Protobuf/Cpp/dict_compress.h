@@ -0,0 +1,56 @@
+#ifndef __DICT_COMPRESS_H__
+#define __DICT_COMPRESS_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// compression for small messages with a shared dictionary.
+// gzip on its own loses below a few hundred bytes: the 18 byte header
+// and trailer and an empty window cost more than it saves. here both
+// sides preload the same dictionary of common byte strings (field
+// names, repeated text), and a message is raw deflate against it.
+
+// picks the byte strings that occur in most of `samples`, up to `size`
+// bytes. greedy like zstd's COVER: the `segment` byte window covering
+// the most not yet covered 6 byte substrings (counted once per sample)
+// is taken next. the best segments end up at the end of the dictionary,
+// closest to the data, where deflate matches are cheapest.
+std::string train_dictionary(const std::vector<std::string>& samples,
+        std::size_t size = 4 * 1024, std::size_t segment = 32);
+
+
+// a deflate stream with the dictionary loaded, copied for every
+// message, and an inflate stream reset for every message.
+// not thread safe, use one per thread.
+class DictCompressor
+{
+public:
+    // level 1: with the dictionary most of a small message is one long
+    // match, the slower levels barely find more
+    explicit DictCompressor(const std::string& dictionary, int level = 1);
+    ~DictCompressor();
+
+    DictCompressor(const DictCompressor&) = delete;
+    DictCompressor& operator=(const DictCompressor&) = delete;
+
+    const std::string& dictionary() const
+    {
+        return dictionary_;
+    }
+
+    // raw deflate, no header or checksum. `out` keeps its storage
+    void compress(const char* data, std::size_t size, std::string& out);
+
+    // false if `data` is not a stream made with the same dictionary.
+    // there is no checksum, a damaged message may decode to wrong bytes
+    bool decompress(const char* data, std::size_t size, std::string& out);
+
+private:
+    std::string dictionary_;
+    z_stream primed_;
+    z_stream inflate_;
+};
+
+#endif // __DICT_COMPRESS_H__
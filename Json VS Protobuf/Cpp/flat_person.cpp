@@ -0,0 +1,115 @@
+#include <cstring>
+
+#include "flat_person.h"
+
+
+namespace flat
+{
+
+namespace
+{
+
+// `count` elements of `width` bytes at `r.offset`, all inside `size`
+bool in_bounds(const Ref& r, std::size_t width, std::size_t align, std::size_t size)
+{
+    return r.offset % align == 0 && r.offset <= size && r.count <= (size - r.offset) / width;
+}
+
+// appends `s` to the string pool
+void put_string(char* base, char*& pool, const std::string& s, Ref& ref)
+{
+    ref.offset = static_cast<uint32_t>(pool - base);
+    ref.count = static_cast<uint32_t>(s.size());
+    std::memcpy(pool, s.data(), s.size());
+    pool += s.size();
+}
+
+}
+
+
+std::size_t encoded_size(const codec::Person& m)
+{
+    std::size_t size = sizeof(PersonRecord) + m.name.size();
+    size += m.tags.size() * sizeof(int32_t);
+    size += m.logs.size() * sizeof(LogRecord);
+    for(auto& log: m.logs)
+    {
+        size += log.content.size();
+    }
+    return size;
+}
+
+std::size_t encode(const codec::Person& m, std::string& out)
+{
+    std::size_t size = encoded_size(m);
+    if(size > UINT32_MAX)
+    {
+        return 0;
+    }
+    out.resize(size);
+
+    char* base = &out[0];
+    PersonRecord head;
+    head.magic = MAGIC;
+    head.size = static_cast<uint32_t>(size);
+    head.id = m.id;
+
+    head.tags.offset = sizeof(PersonRecord);
+    head.tags.count = static_cast<uint32_t>(m.tags.size());
+    std::memcpy(base + head.tags.offset, m.tags.data(), m.tags.size() * sizeof(int32_t));
+
+    head.logs.offset = head.tags.offset + head.tags.count * sizeof(int32_t);
+    head.logs.count = static_cast<uint32_t>(m.logs.size());
+
+    char* pool = base + head.logs.offset + head.logs.count * sizeof(LogRecord);
+    put_string(base, pool, m.name, head.name);
+
+    char* records = base + head.logs.offset;
+    for(auto& log: m.logs)
+    {
+        LogRecord r;
+        r.id = log.id;
+        r.status = log.status;
+        r.times = log.times;
+        put_string(base, pool, log.content, r.content);
+
+        std::memcpy(records, &r, sizeof(r));
+        records += sizeof(r);
+    }
+
+    std::memcpy(base, &head, sizeof(head));
+    return size;
+}
+
+bool verify(const char* data, std::size_t size)
+{
+    if(reinterpret_cast<uintptr_t>(data) % alignof(PersonRecord) != 0 || size < sizeof(PersonRecord))
+    {
+        return false;
+    }
+
+    auto head = reinterpret_cast<const PersonRecord*>(data);
+    if(head->magic != MAGIC || head->size != size)
+    {
+        return false;
+    }
+
+    if(!in_bounds(head->name, 1, 1, size) ||
+            !in_bounds(head->tags, sizeof(int32_t), alignof(int32_t), size) ||
+            !in_bounds(head->logs, sizeof(LogRecord), alignof(LogRecord), size))
+    {
+        return false;
+    }
+
+    auto logs = reinterpret_cast<const LogRecord*>(data + head->logs.offset);
+    for(uint32_t i=0; i<head->logs.count; i++)
+    {
+        if(!in_bounds(logs[i].content, 1, 1, size))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,137 @@
+#ifndef __FLAT_PERSON_H__
+#define __FLAT_PERSON_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "arena.h"
+#include "protocol_codec.h"
+
+// Person in a layout that is read in place, with no decode step.
+//
+//   PersonRecord   header: magic, total size, id and three Refs
+//   int32_t[]      tags
+//   LogRecord[]    logs, fixed size, so logs[i] is base + offset + i * 20
+//   char[]         name and every log content, not terminated
+//
+// every scalar is little endian and 4 byte aligned, a Ref is
+// {offset from the start of the buffer, element count}. the buffer
+// must be 4 byte aligned (any malloc'd or mmap'd buffer is).
+//
+// Person/Log trust the buffer: run verify() once on anything that
+// did not come from encode(), it bounds checks every Ref in one pass.
+namespace flat
+{
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the flat layout is little endian");
+
+// "FLP1" in the file
+const uint32_t MAGIC = 0x31504c46;
+
+struct Ref
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct PersonRecord
+{
+    uint32_t magic;
+    uint32_t size;
+    int32_t id;
+    Ref name;
+    Ref tags;
+    Ref logs;
+};
+
+struct LogRecord
+{
+    int32_t id;
+    int32_t status;
+    int32_t times;
+    Ref content;
+};
+
+static_assert(sizeof(PersonRecord) == 36 && sizeof(LogRecord) == 20, "no padding in the records");
+
+
+class Log
+{
+public:
+    Log(const char* base, const LogRecord* r):
+        base_(base), r_(r)
+    {}
+
+    int32_t id() const { return r_->id; }
+    int32_t status() const { return r_->status; }
+    int32_t times() const { return r_->times; }
+
+    std::string_view content() const
+    {
+        return std::string_view(base_ + r_->content.offset, r_->content.count);
+    }
+
+private:
+    const char* base_;
+    const LogRecord* r_;
+};
+
+
+class Person
+{
+public:
+    explicit Person(const char* data):
+        base_(data), r_(reinterpret_cast<const PersonRecord*>(data))
+    {}
+
+    // false for a view over NULL
+    explicit operator bool() const
+    {
+        return base_ != NULL;
+    }
+
+    int32_t id() const
+    {
+        return r_->id;
+    }
+
+    std::string_view name() const
+    {
+        return std::string_view(base_ + r_->name.offset, r_->name.count);
+    }
+
+    Span<int32_t> tags() const
+    {
+        return Span<int32_t>{reinterpret_cast<const int32_t*>(base_ + r_->tags.offset), r_->tags.count};
+    }
+
+    std::size_t logs_size() const
+    {
+        return r_->logs.count;
+    }
+
+    Log log(std::size_t i) const
+    {
+        return Log(base_, reinterpret_cast<const LogRecord*>(base_ + r_->logs.offset) + i);
+    }
+
+private:
+    const char* base_;
+    const PersonRecord* r_;
+};
+
+
+// exact encoded size
+std::size_t encoded_size(const codec::Person& m);
+
+// encodes into `out`, reusing its storage, returns the size.
+// 0 if the message does not fit in 4 GB.
+std::size_t encode(const codec::Person& m, std::string& out);
+
+// alignment, magic, size, and every Ref inside [data, data + size)
+bool verify(const char* data, std::size_t size);
+
+}
+
+#endif // __FLAT_PERSON_H__
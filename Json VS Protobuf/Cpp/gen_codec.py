@@ -0,0 +1,527 @@
+#!/usr/bin/env python
+"""
+Generate specialized C++ encode/decode routines from a .proto file.
+
+    ./gen_codec.py ../protocol.proto protocol_codec.h
+
+For every message it emits a plain struct, a constexpr field table,
+and inline functions for the protobuf wire format and for json:
+
+    pb_size / pb_encode / pb_decode
+    json_size / json_encode / json_decode
+
+*_size returns the exact encoded size, *_encode writes into a caller
+provided buffer of that size, so encoding never touches the heap.
+
+Only what our schemas use is supported: proto2 messages with
+int32, int64, uint32, uint64, bool, string and nested message fields,
+optionally repeated ([packed=true] allowed on scalars).
+Repeated int32 fields are decoded/encoded in batches (varint_batch.h).
+Optional fields are always written, like required ones.
+"""
+from __future__ import print_function
+
+import os
+import re
+import sys
+
+
+SCALARS = {
+    # proto type: (c++ type, wire type, pb cast, json reader)
+    'int32': ('int32_t', 'WIRE_VARINT', 'static_cast<uint64_t>(static_cast<int64_t>({0}))', 'read_integer'),
+    'int64': ('int64_t', 'WIRE_VARINT', 'static_cast<uint64_t>({0})', 'read_integer'),
+    'uint32': ('uint32_t', 'WIRE_VARINT', 'static_cast<uint64_t>({0})', 'read_integer'),
+    'uint64': ('uint64_t', 'WIRE_VARINT', 'static_cast<uint64_t>({0})', 'read_integer'),
+    'bool': ('bool', 'WIRE_VARINT', 'static_cast<uint64_t>({0})', 'read_bool'),
+}
+
+MESSAGE_RE = re.compile(r'message\s+(\w+)\s*\{(.*?)\}', re.S)
+FIELD_RE = re.compile(r'(required|optional|repeated)\s+(\w+)\s+(\w+)\s*=\s*(\d+)\s*(\[[^\]]*\])?\s*;')
+
+
+class Field(object):
+    def __init__(self, label, type_, name, number, options):
+        self.label = label
+        self.type = type_
+        self.name = name
+        self.number = int(number)
+        self.repeated = label == 'repeated'
+        self.packed = 'packed' in options and 'true' in options
+
+        if self.packed and (not self.repeated or type_ not in SCALARS):
+            raise SystemExit("packed only applies to repeated scalars: %s" % name)
+
+    @property
+    def is_batch_int32(self):
+        """repeated int32, decoded/encoded with varint_batch.h"""
+        return self.repeated and self.type == 'int32'
+
+    @property
+    def is_string(self):
+        return self.type == 'string'
+
+    @property
+    def is_scalar(self):
+        return self.type in SCALARS
+
+    @property
+    def is_message(self):
+        return not self.is_string and not self.is_scalar
+
+    @property
+    def cpp_type(self):
+        if self.is_scalar:
+            return SCALARS[self.type][0]
+        if self.is_string:
+            return 'std::string'
+        return self.type
+
+    @property
+    def wire(self):
+        if self.is_scalar:
+            return SCALARS[self.type][1]
+        return 'WIRE_LENGTH'
+
+    def pb_value(self, expr):
+        return SCALARS[self.type][2].format(expr)
+
+
+class Message(object):
+    def __init__(self, name, body):
+        self.name = name
+        self.fields = []
+        for m in FIELD_RE.finditer(body):
+            self.fields.append(Field(*m.groups(default='')))
+
+    def deps(self):
+        return [f.type for f in self.fields if f.is_message]
+
+
+def parse(text):
+    text = re.sub(r'//[^\n]*', '', text)
+    messages = [Message(name, body) for name, body in MESSAGE_RE.findall(text)]
+
+    names = set(m.name for m in messages)
+    for m in messages:
+        for f in m.fields:
+            if f.is_message and f.type not in names:
+                raise SystemExit("unsupported type %s for field %s.%s" % (f.type, m.name, f.name))
+
+    # a message must be declared before the messages containing it
+    ordered = []
+    pending = list(messages)
+    while pending:
+        for m in pending:
+            if all(d in [o.name for o in ordered] for d in m.deps()):
+                ordered.append(m)
+                pending.remove(m)
+                break
+        else:
+            raise SystemExit("recursive messages are not supported")
+
+    return ordered
+
+
+class Writer(object):
+    def __init__(self):
+        self.lines = []
+        self.indent = 0
+
+    def raw(self, line):
+        self.lines.append(line)
+
+    def __call__(self, line=''):
+        if line.startswith('}'):
+            self.indent -= 1
+        self.lines.append(('    ' * self.indent + line) if line else '')
+        if line.endswith('{'):
+            self.indent += 1
+
+    def text(self):
+        return '\n'.join(self.lines) + '\n'
+
+
+def field_ref(msg, i):
+    return '%s_fields[%d]' % (msg.name, i)
+
+
+def gen_struct(w, msg):
+    w('struct %s' % msg.name)
+    w('{')
+    for f in msg.fields:
+        if f.repeated:
+            w('std::vector<%s> %s;' % (f.cpp_type, f.name))
+        elif f.is_scalar:
+            w('%s %s = 0;' % (f.cpp_type, f.name))
+        else:
+            w('%s %s;' % (f.cpp_type, f.name))
+    w('};')
+    w()
+    w('constexpr FieldInfo %s_fields[] =' % msg.name)
+    w('{')
+    for f in msg.fields:
+        w('make_field(%d, %s, %s, %s, "%s", "\\"%s\\":"),' % (
+            f.number, f.wire, str(f.repeated).lower(), str(f.packed).lower(), f.name, f.name))
+    w('};')
+    w()
+
+
+def gen_clear(w, msg):
+    w('inline void clear(%s& m)' % msg.name)
+    w('{')
+    for f in msg.fields:
+        if f.repeated or not f.is_scalar:
+            w('m.%s.clear();' % f.name)
+        else:
+            w('m.%s = 0;' % f.name)
+    w('}')
+    w()
+
+
+def gen_packed_size(w, f):
+    if f.is_batch_int32:
+        w('std::size_t n = varint::encoded_size_int32(m.%s.data(), m.%s.size());' % (f.name, f.name))
+    else:
+        w('std::size_t n = 0;')
+        w('for(auto v: m.%s) n += varint_size(%s);' % (f.name, f.pb_value('v')))
+
+
+def gen_pb_size(w, msg):
+    w('inline std::size_t pb_size(const %s& m)' % msg.name)
+    w('{')
+    w('std::size_t size = 0;')
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        if f.packed:
+            w('if(!m.%s.empty())' % f.name)
+            w('{')
+            gen_packed_size(w, f)
+            w('size += %s.tag_size + varint_size(n) + n;' % fi)
+            w('}')
+        elif f.repeated and f.is_scalar:
+            w('for(auto v: m.%s) size += %s.tag_size + varint_size(%s);' % (f.name, fi, f.pb_value('v')))
+        elif f.repeated:
+            w('for(auto& v: m.%s)' % f.name)
+            w('{')
+            w('std::size_t n = %s;' % ('v.size()' if f.is_string else 'pb_size(v)'))
+            w('size += %s.tag_size + varint_size(n) + n;' % fi)
+            w('}')
+        elif f.is_scalar:
+            w('size += %s.tag_size + varint_size(%s);' % (fi, f.pb_value('m.' + f.name)))
+        elif f.is_string:
+            w('size += %s.tag_size + varint_size(m.%s.size()) + m.%s.size();' % (fi, f.name, f.name))
+        else:
+            w('{')
+            w('std::size_t n = pb_size(m.%s);' % f.name)
+            w('size += %s.tag_size + varint_size(n) + n;' % fi)
+            w('}')
+    w('return size;')
+    w('}')
+    w()
+
+
+def gen_pb_encode(w, msg):
+    w('inline char* pb_encode(const %s& m, char* p)' % msg.name)
+    w('{')
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        if f.packed:
+            w('if(!m.%s.empty())' % f.name)
+            w('{')
+            gen_packed_size(w, f)
+            w('p = write_varint(p, %s.tag);' % fi)
+            w('p = write_varint(p, n);')
+            if f.is_batch_int32:
+                w('p = varint::encode_int32(m.%s.data(), m.%s.size(), p);' % (f.name, f.name))
+            else:
+                w('for(auto v: m.%s) p = write_varint(p, %s);' % (f.name, f.pb_value('v')))
+            w('}')
+        elif f.repeated and f.is_scalar:
+            w('for(auto v: m.%s)' % f.name)
+            w('{')
+            w('p = write_varint(p, %s.tag);' % fi)
+            w('p = write_varint(p, %s);' % f.pb_value('v'))
+            w('}')
+        elif f.is_scalar:
+            w('p = write_varint(p, %s.tag);' % fi)
+            w('p = write_varint(p, %s);' % f.pb_value('m.' + f.name))
+        else:
+            if f.repeated:
+                w('for(auto& v: m.%s)' % f.name)
+                w('{')
+                value = 'v'
+            else:
+                value = 'm.' + f.name
+            w('p = write_varint(p, %s.tag);' % fi)
+            if f.is_string:
+                w('p = write_varint(p, %s.size());' % value)
+                w('std::memcpy(p, %s.data(), %s.size());' % (value, value))
+                w('p += %s.size();' % value)
+            else:
+                w('p = write_varint(p, pb_size(%s));' % value)
+                w('p = pb_encode(%s, p);' % value)
+            if f.repeated:
+                w('}')
+    w('return p;')
+    w('}')
+    w()
+
+
+def gen_pb_merge(w, msg):
+    w('inline bool pb_merge(const char* p, const char* end, %s& m)' % msg.name)
+    w('{')
+    w('while(p < end)')
+    w('{')
+    w('uint64_t key;')
+    w('if(!read_varint(p, end, key)) return false;')
+    w()
+    w('switch(key)')
+    w('{')
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        if f.is_scalar:
+            w('case make_tag(%s.number, WIRE_VARINT):' % fi)
+            w('{')
+            w('uint64_t v;')
+            w('if(!read_varint(p, end, v)) return false;')
+            if f.repeated:
+                w('m.%s.push_back(static_cast<%s>(v));' % (f.name, f.cpp_type))
+            else:
+                w('m.%s = static_cast<%s>(v);' % (f.name, f.cpp_type))
+            if f.is_batch_int32 and f.number < 16:
+                # unpacked entries usually come in a run, with a one byte key
+                w('p = varint::append_tagged_int32(p, end, static_cast<uint8_t>(key), m.%s);' % f.name)
+                w('if(!p) return false;')
+            w('break;')
+            w('}')
+            if f.repeated:
+                # parsers must accept both packed and unpacked encodings
+                w('case make_tag(%s.number, WIRE_LENGTH):' % fi)
+                w('{')
+                w('uint64_t n;')
+                w('if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;')
+                w('const char* stop = p + n;')
+                if f.is_batch_int32:
+                    w('if(!varint::append_int32(p, stop, m.%s)) return false;' % f.name)
+                    w('p = stop;')
+                else:
+                    w('while(p < stop)')
+                    w('{')
+                    w('uint64_t v;')
+                    w('if(!read_varint(p, stop, v)) return false;')
+                    w('m.%s.push_back(static_cast<%s>(v));' % (f.name, f.cpp_type))
+                    w('}')
+                w('break;')
+                w('}')
+        else:
+            w('case %s.tag:' % fi)
+            w('{')
+            w('uint64_t n;')
+            w('if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;')
+            if f.repeated:
+                w('m.%s.emplace_back();' % f.name)
+                target = 'm.%s.back()' % f.name
+            else:
+                target = 'm.' + f.name
+            if f.is_string:
+                w('%s.assign(p, n);' % target)
+            else:
+                w('if(!pb_merge(p, p + n, %s)) return false;' % target)
+            w('p += n;')
+            w('break;')
+            w('}')
+    w('default:')
+    w('    if(!skip_field(p, end, key & 7)) return false;')
+    w('}')
+    w('}')
+    w('return true;')
+    w('}')
+    w()
+
+
+def gen_json_value_size(f, value):
+    if f.type == 'bool':
+        return '(%s ? 4 : 5)' % value
+    if f.is_scalar:
+        return 'decimal_size(static_cast<%s>(%s))' % (
+            'uint64_t' if f.type.startswith('uint') else 'int64_t', value)
+    if f.is_string:
+        return 'json_string_size(%s)' % value
+    return 'json_size(%s)' % value
+
+
+def gen_json_write_value(w, f, value):
+    if f.type == 'bool':
+        w('p = write_raw(p, %s ? "true" : "false");' % value)
+    elif f.is_scalar:
+        w('p = write_decimal(p, static_cast<%s>(%s));' % (
+            'uint64_t' if f.type.startswith('uint') else 'int64_t', value))
+    elif f.is_string:
+        w('p = write_json_string(p, %s);' % value)
+    else:
+        w('p = json_encode(%s, p);' % value)
+
+
+def gen_json_size(w, msg):
+    w('inline std::size_t json_size(const %s& m)' % msg.name)
+    w('{')
+    # braces and the commas between members
+    w('std::size_t size = 2 + %d;' % max(len(msg.fields) - 1, 0))
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        w('size += %s.json_key.size();' % fi)
+        if f.repeated:
+            w('size += 2 + (m.%s.empty() ? 0 : m.%s.size() - 1);' % (f.name, f.name))
+            w('for(auto& v: m.%s) size += %s;' % (f.name, gen_json_value_size(f, 'v')))
+        else:
+            w('size += %s;' % gen_json_value_size(f, 'm.' + f.name))
+    w('return size;')
+    w('}')
+    w()
+
+
+def gen_json_encode(w, msg):
+    w('inline char* json_encode(const %s& m, char* p)' % msg.name)
+    w('{')
+    w("*p++ = '{';")
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        if i:
+            w("*p++ = ',';")
+        w('p = write_raw(p, %s.json_key);' % fi)
+        if f.repeated:
+            w("*p++ = '[';")
+            w('for(std::size_t i=0; i<m.%s.size(); i++)' % f.name)
+            w('{')
+            w("if(i) *p++ = ',';")
+            gen_json_write_value(w, f, 'm.%s[i]' % f.name)
+            w('}')
+            w("*p++ = ']';")
+        else:
+            gen_json_write_value(w, f, 'm.' + f.name)
+    w("*p++ = '}';")
+    w('return p;')
+    w('}')
+    w()
+
+
+def gen_json_read_value(f, target):
+    if f.is_scalar:
+        return 'r.%s(%s)' % (SCALARS[f.type][3], target)
+    if f.is_string:
+        return 'r.read_string(%s)' % target
+    return 'json_merge(r, %s)' % target
+
+
+def gen_json_merge(w, msg):
+    w('template<class Reader>')
+    w('inline bool json_merge(Reader& r, %s& m)' % msg.name)
+    w('{')
+    w('if(!r.begin_object()) return false;')
+    w('if(r.end_object()) return true;')
+    w()
+    w('do')
+    w('{')
+    w('std::string_view key;')
+    w('if(!r.read_key(key)) return false;')
+    w('if(r.read_null()) continue;')
+    w()
+    for i, f in enumerate(msg.fields):
+        fi = field_ref(msg, i)
+        w('%sif(key == %s.name)' % ('else ' if i else '', fi))
+        w('{')
+        if f.repeated:
+            w('if(!r.begin_array()) return false;')
+            w('if(!r.end_array())')
+            w('{')
+            w('do')
+            w('{')
+            if f.is_scalar:
+                w('%s v;' % f.cpp_type)
+                w('if(!%s) return false;' % gen_json_read_value(f, 'v'))
+                w('m.%s.push_back(v);' % f.name)
+            else:
+                w('m.%s.emplace_back();' % f.name)
+                w('if(!%s) return false;' % gen_json_read_value(f, 'm.%s.back()' % f.name))
+            w('} while(r.next_element());')
+            w('if(!r.ok()) return false;')
+            w('}')
+        else:
+            w('if(!%s) return false;' % gen_json_read_value(f, 'm.' + f.name))
+        w('}')
+    w('else if(!r.skip_value())')
+    w('{')
+    w('return false;')
+    w('}')
+    w('} while(r.next_member());')
+    w()
+    w('return r.ok();')
+    w('}')
+    w()
+
+
+def gen_entry_points(w, msg):
+    w('inline bool pb_decode(const char* data, std::size_t size, %s& m)' % msg.name)
+    w('{')
+    w('clear(m);')
+    w('return pb_merge(data, data + size, m);')
+    w('}')
+    w()
+    w('inline bool json_decode(const char* data, std::size_t size, %s& m)' % msg.name)
+    w('{')
+    w('JsonReader r(data, data + size);')
+    w('clear(m);')
+    w('return json_merge(r, m) && r.at_end();')
+    w('}')
+    w()
+
+
+def generate(proto_path, messages):
+    guard = '__%s__' % re.sub(r'\W', '_', os.path.basename(proto_path).replace('.proto', '_codec.h')).upper()
+
+    w = Writer()
+    w('// Generated by gen_codec.py from %s, do not edit.' % os.path.basename(proto_path))
+    w('#ifndef %s' % guard)
+    w('#define %s' % guard)
+    w()
+    w('#include <cstdint>')
+    w('#include <string>')
+    w('#include <vector>')
+    w()
+    w('#include "codec_runtime.h"')
+    w('#include "varint_batch.h"')
+    w()
+    w('namespace codec')
+    w.raw('{')
+    w()
+    for msg in messages:
+        gen_struct(w, msg)
+        gen_clear(w, msg)
+        gen_pb_size(w, msg)
+        gen_pb_encode(w, msg)
+        gen_pb_merge(w, msg)
+        gen_json_size(w, msg)
+        gen_json_encode(w, msg)
+        gen_json_merge(w, msg)
+        gen_entry_points(w, msg)
+    w.raw('}')
+    w()
+    w('#endif // %s' % guard)
+    return w.text()
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("usage: ./gen_codec.py [PROTO FILE] [OUTPUT HEADER]")
+        sys.exit(1)
+
+    proto_path, output = sys.argv[1], sys.argv[2]
+    with open(proto_path) as f:
+        messages = parse(f.read())
+
+    with open(output, 'w') as f:
+        f.write(generate(proto_path, messages))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <cstdlib>
+#include <zlib.h>
+
+#include "gzip.h"
+
+
+std::string gzip_compress(const std::string& data, int level)
+{
+    z_stream zs = z_stream();
+    // 15 window bits + 16 for the gzip header
+    if(deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std::cout << "deflateInit2 failed" << std::endl;
+        exit(1);
+    }
+
+    std::string out;
+    out.resize(deflateBound(&zs, data.size()));
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+
+    if(deflate(&zs, Z_FINISH) != Z_STREAM_END)
+    {
+        std::cout << "deflate failed" << std::endl;
+        exit(1);
+    }
+
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+
+std::string gzip_decompress(const std::string& data)
+{
+    z_stream zs = z_stream();
+    if(inflateInit2(&zs, 15 + 16) != Z_OK)
+    {
+        std::cout << "inflateInit2 failed" << std::endl;
+        exit(1);
+    }
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+
+    std::string out;
+    char buffer[4096];
+    int ret;
+    do
+    {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if(ret != Z_OK && ret != Z_STREAM_END)
+        {
+            std::cout << "inflate failed: " << ret << std::endl;
+            exit(1);
+        }
+
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    } while(ret != Z_STREAM_END);
+
+    inflateEnd(&zs);
+    return out;
+}
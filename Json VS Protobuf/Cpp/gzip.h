@@ -0,0 +1,10 @@
+#ifndef __GZIP_H__
+#define __GZIP_H__
+
+#include <string>
+
+// gzip format (not raw deflate), same as the data.json.gz fixture
+std::string gzip_compress(const std::string& data, int level = 6);
+std::string gzip_decompress(const std::string& data);
+
+#endif // __GZIP_H__
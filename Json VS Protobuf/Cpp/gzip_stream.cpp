@@ -0,0 +1,183 @@
+#include <zlib.h>
+
+#include "gzip_stream.h"
+#include "json_stream.h"
+
+
+bool gunzip_json_stream(const char* data, std::size_t size, codec::Person& out, std::size_t chunk_size)
+{
+    z_stream zs = z_stream();
+    // 15 window bits + 16 for the gzip header
+    if(inflateInit2(&zs, 15 + 16) != Z_OK)
+    {
+        return false;
+    }
+
+    json_stream::PersonHandler handler(out);
+    json_stream::StreamParser<json_stream::PersonHandler> parser(handler);
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = size;
+
+    std::vector<char> buffer(chunk_size);
+    int ret;
+    bool ok = true;
+    do
+    {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        zs.avail_out = buffer.size();
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if(ret != Z_OK && ret != Z_STREAM_END)
+        {
+            ok = false;
+            break;
+        }
+
+        ok = parser.feed(buffer.data(), buffer.size() - zs.avail_out);
+    } while(ok && ret != Z_STREAM_END);
+
+    inflateEnd(&zs);
+    return ok && parser.finish();
+}
+
+
+GunzipPipeline::GunzipPipeline(std::size_t chunk_size, std::size_t chunks):
+    storage_(chunks), job_data_(NULL), job_size_(0), has_job_(false),
+    job_done_(false), job_ok_(false), abort_(false), stop_(false)
+{
+    for(auto& chunk: storage_)
+    {
+        chunk.data.resize(chunk_size);
+        chunk.size = 0;
+        free_.push_back(&chunk);
+    }
+    thread_ = std::thread([this]() { inflate_loop(); });
+}
+
+GunzipPipeline::~GunzipPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+bool GunzipPipeline::decode(const char* data, std::size_t size, codec::Person& out)
+{
+    json_stream::PersonHandler handler(out);
+    json_stream::StreamParser<json_stream::PersonHandler> parser(handler);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_data_ = data;
+    job_size_ = size;
+    has_job_ = true;
+    job_done_ = false;
+    job_ok_ = false;
+    abort_ = false;
+    cond_.notify_all();
+
+    bool ok = true;
+    while(true)
+    {
+        cond_.wait(lock, [this]() { return !full_.empty() || job_done_; });
+        if(full_.empty())
+        {
+            // job_done_ and every chunk consumed
+            break;
+        }
+
+        Chunk* chunk = full_.front();
+        full_.pop_front();
+
+        if(ok)
+        {
+            lock.unlock();
+            ok = parser.feed(chunk->data.data(), chunk->size);
+            lock.lock();
+            abort_ = !ok;
+        }
+
+        free_.push_back(chunk);
+        cond_.notify_all();
+    }
+
+    return ok && job_ok_ && parser.finish();
+}
+
+void GunzipPipeline::inflate_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        cond_.wait(lock, [this]() { return has_job_ || stop_; });
+        if(stop_) return;
+
+        has_job_ = false;
+        const char* data = job_data_;
+        std::size_t size = job_size_;
+
+        lock.unlock();
+        bool ok = inflate_job(data, size);
+        lock.lock();
+
+        job_ok_ = ok;
+        job_done_ = true;
+        cond_.notify_all();
+    }
+}
+
+bool GunzipPipeline::inflate_job(const char* data, std::size_t size)
+{
+    z_stream zs = z_stream();
+    if(inflateInit2(&zs, 15 + 16) != Z_OK)
+    {
+        return false;
+    }
+
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = size;
+
+    int ret;
+    bool ok = true;
+    do
+    {
+        Chunk* chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return !free_.empty() || abort_ || stop_; });
+            if(abort_ || stop_)
+            {
+                ok = false;
+                break;
+            }
+            chunk = free_.front();
+            free_.pop_front();
+        }
+
+        zs.next_out = reinterpret_cast<Bytef*>(chunk->data.data());
+        zs.avail_out = chunk->data.size();
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        ok = ret == Z_OK || ret == Z_STREAM_END;
+        chunk->size = chunk->data.size() - zs.avail_out;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(ok)
+            {
+                full_.push_back(chunk);
+            }
+            else
+            {
+                free_.push_back(chunk);
+            }
+        }
+        cond_.notify_all();
+    } while(ok && ret != Z_STREAM_END);
+
+    inflateEnd(&zs);
+    return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef __GZIP_STREAM_H__
+#define __GZIP_STREAM_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "protocol_codec.h"
+
+// gzip'd json -> codec::Person without holding the inflated text.
+// each inflated chunk goes straight into json_stream::StreamParser,
+// so memory stays at one chunk however big the payload is.
+// false if the gzip stream or the json is broken.
+bool gunzip_json_stream(const char* data, std::size_t size, codec::Person& out,
+        std::size_t chunk_size = 4 * 1024);
+
+
+// same, but inflate runs on its own thread, one chunk ahead of the parser.
+// the two hand chunks over through a bounded queue, so at most
+// `chunks` buffers of `chunk_size` exist at any time.
+// the thread is started once and serves every decode() call.
+class GunzipPipeline
+{
+public:
+    GunzipPipeline(std::size_t chunk_size = 64 * 1024, std::size_t chunks = 4);
+    ~GunzipPipeline();
+
+    GunzipPipeline(const GunzipPipeline&) = delete;
+    GunzipPipeline& operator=(const GunzipPipeline&) = delete;
+
+    bool decode(const char* data, std::size_t size, codec::Person& out);
+
+private:
+    struct Chunk
+    {
+        std::vector<char> data;
+        std::size_t size;
+    };
+
+    void inflate_loop();
+    bool inflate_job(const char* data, std::size_t size);
+
+    std::vector<Chunk> storage_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Chunk*> free_;
+    std::deque<Chunk*> full_;
+
+    const char* job_data_;
+    std::size_t job_size_;
+    bool has_job_;
+    // set by the inflater once the job has no more chunks
+    bool job_done_;
+    bool job_ok_;
+    // set by the parser to make the inflater give up early
+    bool abort_;
+    bool stop_;
+
+    std::thread thread_;
+};
+
+#endif // __GZIP_STREAM_H__
@@ -0,0 +1,128 @@
+#include <cmath>
+
+#include "harness.h"
+
+
+namespace harness
+{
+
+namespace
+{
+
+// linear interpolation between the closest ranks of sorted `v`
+double percentile(const std::vector<double>& v, double p)
+{
+    double rank = p / 100 * (v.size() - 1);
+    std::size_t lo = static_cast<std::size_t>(rank);
+    std::size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+}
+
+void write_number(std::ostream& out, double v)
+{
+    if(std::isfinite(v)) out << v;
+    else out << "null";
+}
+
+}
+
+
+Summary summarize(std::vector<double> samples)
+{
+    Summary s = Summary();
+    if(samples.empty()) return s;
+
+    std::sort(samples.begin(), samples.end());
+    std::size_t n = samples.size();
+
+    double sum = 0;
+    for(double v: samples) sum += v;
+    s.mean = sum / n;
+
+    double sq = 0;
+    for(double v: samples) sq += (v - s.mean) * (v - s.mean);
+    s.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0;
+
+    s.min = samples.front();
+    s.max = samples.back();
+    s.median = percentile(samples, 50);
+    s.p5 = percentile(samples, 5);
+    s.p25 = percentile(samples, 25);
+    s.p75 = percentile(samples, 75);
+    s.p95 = percentile(samples, 95);
+
+    // the median lies between these (1 based) ranks with ~95%
+    // probability, whatever the distribution of the samples
+    double half = 1.96 * std::sqrt(static_cast<double>(n)) / 2;
+    double lo = std::floor(n / 2.0 - half);
+    double hi = std::ceil(n / 2.0 + half) + 1;
+    s.ci_low = samples[static_cast<std::size_t>(std::max(1.0, lo)) - 1];
+    s.ci_high = samples[static_cast<std::size_t>(std::min<double>(n, hi)) - 1];
+    return s;
+}
+
+
+void write_json(std::ostream& out, const std::string& language, const Options& options,
+        const std::vector<SizeRow>& sizes, const std::vector<Result>& results)
+{
+    out << "{\n";
+    out << "  \"language\": \"" << language << "\",\n";
+    out << "  \"samples\": " << options.samples << ",\n";
+    out << "  \"warmup_seconds\": " << options.warmup_seconds << ",\n";
+    out << "  \"sample_seconds\": " << options.sample_seconds << ",\n";
+
+    out << "  \"sizes\": [\n";
+    for(std::size_t i=0; i<sizes.size(); i++)
+    {
+        out << "    {\"logs\": " << sizes[i].logs;
+        for(auto& kv: sizes[i].sizes)
+        {
+            out << ", \"" << kv.first << "\": " << kv.second;
+        }
+        out << "}" << (i + 1 < sizes.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"results\": [\n";
+    for(std::size_t i=0; i<results.size(); i++)
+    {
+        const Result& r = results[i];
+        const Summary& s = r.ns;
+
+        out << "    {\n";
+        out << "      \"group\": \"" << r.group << "\",\n";
+        out << "      \"name\": \"" << r.name << "\",\n";
+        out << "      \"calls_per_sample\": " << r.calls_per_sample << ",\n";
+        out << "      \"ns\": {\"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+            << ", \"min\": " << s.min << ", \"max\": " << s.max
+            << ", \"median\": " << s.median << ", \"p5\": " << s.p5 << ", \"p25\": " << s.p25
+            << ", \"p75\": " << s.p75 << ", \"p95\": " << s.p95
+            << ", \"ci95\": [" << s.ci_low << ", " << s.ci_high << "]},\n";
+        out << "      \"allocs_per_op\": ";
+        write_number(out, r.allocs_per_call);
+        out << ",\n      \"bytes_per_op\": ";
+        write_number(out, r.bytes_per_call);
+        out << ",\n";
+
+        for(int c=0; c<PerfCounters::COUNT; c++)
+        {
+            auto counter = static_cast<PerfCounters::Counter>(c);
+            out << "      \"" << PerfCounters::name(counter) << "_per_op\": ";
+            if(r.perf) write_number(out, r.counters[c]);
+            else out << "null";
+            out << ",\n";
+        }
+
+        out << "      \"samples\": [";
+        for(std::size_t j=0; j<r.samples.size(); j++)
+        {
+            out << (j ? ", " : "") << r.samples[j];
+        }
+        out << "]\n";
+        out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+}
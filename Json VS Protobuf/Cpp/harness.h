@@ -0,0 +1,136 @@
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "perf_counters.h"
+
+// repeated measurement of one operation: a warmup that also picks how
+// many calls make up one sample, then `samples` timed samples.
+// results go to a json file that report.py turns into the README
+// tables and chart.
+namespace harness
+{
+
+struct Options
+{
+    int samples = 30;
+    double warmup_seconds = 0.2;
+    // each sample runs about this long
+    double sample_seconds = 0.02;
+};
+
+// of the per-call nanoseconds of every sample
+struct Summary
+{
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double median;
+    double p5;
+    double p25;
+    double p75;
+    double p95;
+    // 95% confidence interval of the median, from order statistics
+    double ci_low;
+    double ci_high;
+};
+
+Summary summarize(std::vector<double> samples);
+
+struct Result
+{
+    std::string group;
+    std::string name;
+    std::size_t calls_per_sample;
+    // nanoseconds per call
+    std::vector<double> samples;
+    Summary ns;
+    double allocs_per_call;
+    double bytes_per_call;
+    // per call, only when perf counters could be opened
+    bool perf;
+    double counters[PerfCounters::COUNT];
+};
+
+// encoded sizes at one log amount
+struct SizeRow
+{
+    int logs;
+    std::vector<std::pair<std::string, std::size_t>> sizes;
+};
+
+template<class F>
+Result run(const std::string& group, const std::string& name, F func, const Options& options,
+        PerfCounters& perf)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Result r;
+    r.group = group;
+    r.name = name;
+
+    std::size_t calls = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do
+    {
+        func();
+        calls++;
+        elapsed = Clock::now() - start;
+    } while(elapsed.count() < options.warmup_seconds);
+
+    double per_call = elapsed.count() / calls;
+    r.calls_per_sample = std::max<std::size_t>(1, static_cast<std::size_t>(options.sample_seconds / per_call));
+
+    // no allocation of our own inside the measured part
+    r.samples.reserve(options.samples);
+
+    std::size_t allocs = allocations();
+    std::size_t bytes = allocated_bytes();
+    uint64_t counters[PerfCounters::COUNT] = {};
+
+    for(int s=0; s<options.samples; s++)
+    {
+        perf.start();
+        auto t = Clock::now();
+        for(std::size_t i=0; i<r.calls_per_sample; i++)
+        {
+            func();
+        }
+        std::chrono::duration<double, std::nano> ns = Clock::now() - t;
+        perf.stop();
+
+        r.samples.push_back(ns.count() / r.calls_per_sample);
+        for(int c=0; c<PerfCounters::COUNT; c++)
+        {
+            counters[c] += perf.read(static_cast<PerfCounters::Counter>(c));
+        }
+    }
+
+    double total = static_cast<double>(r.calls_per_sample) * options.samples;
+    r.ns = summarize(r.samples);
+    r.allocs_per_call = (allocations() - allocs) / total;
+    r.bytes_per_call = (allocated_bytes() - bytes) / total;
+    r.perf = perf.available();
+    for(int c=0; c<PerfCounters::COUNT; c++)
+    {
+        r.counters[c] = counters[c] / total;
+    }
+    return r;
+}
+
+void write_json(std::ostream& out, const std::string& language, const Options& options,
+        const std::vector<SizeRow>& sizes, const std::vector<Result>& results);
+
+}
+
+#endif // __HARNESS_H__
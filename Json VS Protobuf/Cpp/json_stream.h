@@ -0,0 +1,514 @@
+#ifndef __JSON_STREAM_H__
+#define __JSON_STREAM_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "protocol_codec.h"
+
+// incremental (push) json parsing: the text arrives in chunks of any
+// size and the handler gets SAX style events as soon as each token is
+// complete. only tokens cut by a chunk boundary are copied.
+namespace json_stream
+{
+
+// Handler needs:
+//   bool start_object(); bool end_object();
+//   bool start_array();  bool end_array();
+//   bool key(std::string_view);    bool string(std::string_view);
+//   bool number(std::string_view); bool boolean(bool); bool null();
+// returning false stops the parse.
+template<class Handler>
+class StreamParser
+{
+public:
+    explicit StreamParser(Handler& handler):
+        handler_(handler)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        state_ = VALUE;
+        token_ = NONE;
+        stack_.clear();
+        spill_.clear();
+        escape_ = false;
+        has_escape_ = false;
+        error_ = false;
+    }
+
+    bool feed(const char* p, std::size_t size)
+    {
+        const char* end = p + size;
+        if(error_) return false;
+
+        if(token_ != NONE)
+        {
+            p = scan_token(p, p, end);
+            if(!p) return false;
+        }
+
+        while(p < end)
+        {
+            char c = *p;
+            if(c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                p++;
+                continue;
+            }
+
+            switch(state_)
+            {
+            case VALUE:
+            case FIRST_VALUE:
+                if(c == ']' && state_ == FIRST_VALUE)
+                {
+                    if(!close(']')) return false;
+                    p++;
+                    break;
+                }
+                if(c == '{')
+                {
+                    stack_.push_back('{');
+                    state_ = FIRST_KEY;
+                    if(!handler_.start_object()) return fail();
+                    p++;
+                }
+                else if(c == '[')
+                {
+                    stack_.push_back('[');
+                    state_ = FIRST_VALUE;
+                    if(!handler_.start_array()) return fail();
+                    p++;
+                }
+                else if(c == '"')
+                {
+                    p = begin_token(STRING, p + 1, end);
+                }
+                else if(c == '-' || static_cast<unsigned>(c - '0') < 10)
+                {
+                    p = begin_token(NUMBER, p, end);
+                }
+                else if(c == 't' || c == 'f' || c == 'n')
+                {
+                    p = begin_token(LITERAL, p, end);
+                }
+                else
+                {
+                    return fail();
+                }
+                break;
+
+            case FIRST_KEY:
+            case KEY:
+                if(c == '}' && state_ == FIRST_KEY)
+                {
+                    if(!close('}')) return false;
+                    p++;
+                }
+                else if(c == '"')
+                {
+                    p = begin_token(KEY_STRING, p + 1, end);
+                }
+                else
+                {
+                    return fail();
+                }
+                break;
+
+            case COLON:
+                if(c != ':') return fail();
+                state_ = VALUE;
+                p++;
+                break;
+
+            case AFTER_VALUE:
+                if(c == ',')
+                {
+                    state_ = stack_.back() == '{' ? KEY : VALUE;
+                    p++;
+                }
+                else if(c == '}' || c == ']')
+                {
+                    if(!close(c)) return false;
+                    p++;
+                }
+                else
+                {
+                    return fail();
+                }
+                break;
+
+            case DONE:
+                return fail();
+            }
+
+            if(!p) return false;
+        }
+        return true;
+    }
+
+    // true if exactly one complete value was seen
+    bool finish()
+    {
+        if(error_) return false;
+        if(token_ == NUMBER || token_ == LITERAL)
+        {
+            // a top level scalar ends with the input
+            if(!complete(spill_)) return false;
+        }
+        return token_ == NONE && state_ == DONE;
+    }
+
+private:
+    enum State
+    {
+        VALUE,
+        FIRST_VALUE,
+        FIRST_KEY,
+        KEY,
+        COLON,
+        AFTER_VALUE,
+        DONE,
+    };
+
+    enum Token
+    {
+        NONE,
+        STRING,
+        KEY_STRING,
+        NUMBER,
+        LITERAL,
+    };
+
+    bool fail()
+    {
+        error_ = true;
+        return false;
+    }
+
+    static bool is_delimiter(char c)
+    {
+        return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    bool close(char c)
+    {
+        if(stack_.empty() || stack_.back() != (c == '}' ? '{' : '[')) return fail();
+        stack_.pop_back();
+        if(!(c == '}' ? handler_.end_object() : handler_.end_array())) return fail();
+        return value_done();
+    }
+
+    bool value_done()
+    {
+        state_ = stack_.empty() ? DONE : AFTER_VALUE;
+        return true;
+    }
+
+    const char* begin_token(Token token, const char* start, const char* end)
+    {
+        token_ = token;
+        spill_.clear();
+        escape_ = false;
+        has_escape_ = false;
+        return scan_token(start, start, end);
+    }
+
+    // scan from `p`; the token text in this chunk starts at `start`.
+    // returns where parsing continues, or NULL on error.
+    const char* scan_token(const char* start, const char* p, const char* end)
+    {
+        if(token_ == STRING || token_ == KEY_STRING)
+        {
+            while(p < end)
+            {
+                if(escape_)
+                {
+                    escape_ = false;
+                    p++;
+                    continue;
+                }
+
+                // fast path over plain characters
+                while(p < end && *p != '"' && *p != '\\')
+                {
+                    p++;
+                }
+                if(p == end) break;
+
+                if(*p == '\\')
+                {
+                    escape_ = true;
+                    has_escape_ = true;
+                    p++;
+                    continue;
+                }
+
+                if(!complete(text(start, p))) return NULL;
+                return p + 1;
+            }
+        }
+        else
+        {
+            // numbers and literals both end at the first delimiter
+            while(p < end && !is_delimiter(*p))
+            {
+                p++;
+            }
+            if(p < end)
+            {
+                return complete(text(start, p)) ? p : NULL;
+            }
+        }
+
+        // the token continues in the next chunk
+        spill_.append(start, end - start);
+        return end;
+    }
+
+    std::string_view text(const char* start, const char* p)
+    {
+        if(spill_.empty())
+        {
+            return std::string_view(start, p - start);
+        }
+        spill_.append(start, p - start);
+        return spill_;
+    }
+
+    bool complete(std::string_view t)
+    {
+        Token token = token_;
+        token_ = NONE;
+
+        if((token == STRING || token == KEY_STRING) && has_escape_)
+        {
+            quoted_.assign(1, '"');
+            quoted_.append(t.data(), t.size());
+            quoted_ += '"';
+
+            codec::JsonReader r(quoted_.data(), quoted_.data() + quoted_.size());
+            if(!r.read_string(unescaped_)) return fail();
+            t = unescaped_;
+        }
+
+        bool ok;
+        switch(token)
+        {
+        case KEY_STRING:
+            state_ = COLON;
+            return handler_.key(t) || fail();
+        case STRING:
+            ok = handler_.string(t);
+            break;
+        case NUMBER:
+            ok = handler_.number(t);
+            break;
+        default:
+            if(t == "true" || t == "false") ok = handler_.boolean(t == "true");
+            else if(t == "null") ok = handler_.null();
+            else ok = false;
+        }
+        return (ok || fail()) && value_done();
+    }
+
+    Handler& handler_;
+    State state_;
+    Token token_;
+    std::vector<char> stack_;
+    // part of the current token from earlier chunks
+    std::string spill_;
+    bool escape_;
+    bool has_escape_;
+    bool error_;
+    std::string quoted_;
+    std::string unescaped_;
+};
+
+
+// builds a codec::Person from StreamParser events,
+// members it does not know are skipped
+class PersonHandler
+{
+public:
+    explicit PersonHandler(codec::Person& out):
+        out_(out), field_(-1), skip_(0)
+    {
+        codec::clear(out_);
+    }
+
+    void reset()
+    {
+        codec::clear(out_);
+        stack_.clear();
+        field_ = -1;
+        skip_ = 0;
+    }
+
+    bool start_object()
+    {
+        if(skip_) return ++skip_;
+        if(stack_.empty())
+        {
+            stack_.push_back(PERSON);
+            return true;
+        }
+        if(stack_.back() == LOGS)
+        {
+            out_.logs.emplace_back();
+            stack_.push_back(LOG);
+            return true;
+        }
+        return skip_container();
+    }
+
+    bool end_object()
+    {
+        if(skip_) return --skip_ >= 0;
+        stack_.pop_back();
+        return true;
+    }
+
+    bool start_array()
+    {
+        if(skip_) return ++skip_;
+        if(stack_.empty()) return false;
+        if(stack_.back() == PERSON && field_ == TAGS_FIELD)
+        {
+            stack_.push_back(TAGS);
+            return true;
+        }
+        if(stack_.back() == PERSON && field_ == LOGS_FIELD)
+        {
+            stack_.push_back(LOGS);
+            return true;
+        }
+        return skip_container();
+    }
+
+    bool end_array()
+    {
+        if(skip_) return --skip_ >= 0;
+        stack_.pop_back();
+        return true;
+    }
+
+    bool key(std::string_view k)
+    {
+        if(skip_) return true;
+
+        field_ = -1;
+        auto& fields = stack_.back() == PERSON ? codec::Person_fields : codec::Log_fields;
+        for(int i=0; i<4; i++)
+        {
+            if(k == fields[i].name)
+            {
+                field_ = i;
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool string(std::string_view v)
+    {
+        if(skip_ || in_object_unknown()) return true;
+
+        if(stack_.back() == PERSON && field_ == NAME_FIELD)
+        {
+            out_.name.assign(v.data(), v.size());
+            return true;
+        }
+        if(stack_.back() == LOG && field_ == CONTENT_FIELD)
+        {
+            out_.logs.back().content.assign(v.data(), v.size());
+            return true;
+        }
+        return false;
+    }
+
+    bool number(std::string_view v)
+    {
+        if(skip_ || in_object_unknown()) return true;
+
+        int32_t n;
+        const char* p = v.data();
+        if(!codec::parse_integer(p, v.data() + v.size(), n) || p != v.data() + v.size()) return false;
+
+        switch(stack_.back())
+        {
+        case TAGS:
+            out_.tags.push_back(n);
+            return true;
+        case PERSON:
+            if(field_ != ID_FIELD) return false;
+            out_.id = n;
+            return true;
+        case LOG:
+            if(field_ == ID_FIELD) out_.logs.back().id = n;
+            else if(field_ == STATUS_FIELD) out_.logs.back().status = n;
+            else if(field_ == TIMES_FIELD) out_.logs.back().times = n;
+            else return false;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool boolean(bool)
+    {
+        return skip_ || in_object_unknown();
+    }
+
+    bool null()
+    {
+        // null leaves a known field unset
+        return skip_ || stack_.back() == PERSON || stack_.back() == LOG;
+    }
+
+private:
+    enum Kind
+    {
+        PERSON,
+        LOG,
+        TAGS,
+        LOGS,
+    };
+
+    // indexes into Person_fields / Log_fields
+    enum
+    {
+        ID_FIELD = 0,
+        NAME_FIELD = 1,
+        CONTENT_FIELD = 1,
+        TAGS_FIELD = 2,
+        STATUS_FIELD = 2,
+        LOGS_FIELD = 3,
+        TIMES_FIELD = 3,
+    };
+
+    bool in_object_unknown() const
+    {
+        return (stack_.back() == PERSON || stack_.back() == LOG) && field_ < 0;
+    }
+
+    bool skip_container()
+    {
+        if(!in_object_unknown()) return false;
+        skip_ = 1;
+        return true;
+    }
+
+    codec::Person& out_;
+    std::vector<Kind> stack_;
+    int field_;
+    int skip_;
+};
+
+}
+
+#endif // __JSON_STREAM_H__
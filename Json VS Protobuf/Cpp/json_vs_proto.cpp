@@ -0,0 +1,204 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "json_vs_proto.h"
+#include "gzip.h"
+#include "gzip_stream.h"
+
+using google::protobuf::util::JsonPrintOptions;
+using google::protobuf::util::JsonParseOptions;
+using google::protobuf::util::MessageToJsonString;
+using google::protobuf::util::JsonStringToMessage;
+
+
+Pack::Pack(int log_amount)
+{
+    person_.id = 1;
+    person_.name = "My Playground!!!";
+    person_.tags = get_tags();
+    person_.logs = get_logs(log_amount);
+}
+
+std::vector<int32_t> Pack::get_tags()
+{
+    std::vector<int32_t> tags;
+    for(int i=0; i<20; i++)
+    {
+        tags.push_back(i);
+    }
+    return tags;
+}
+
+std::vector<codec::Log> Pack::get_logs(int amount)
+{
+    std::vector<codec::Log> logs;
+    for(int i=0; i<amount; i++)
+    {
+        logs.push_back(codec::Log{i, "Log Contents..." + std::to_string(i), i % 2, 10000000 + i});
+    }
+    return logs;
+}
+
+Person Pack::create_msg() const
+{
+    Person msg;
+    msg.set_id(person_.id);
+    msg.set_name(person_.name);
+    for(auto tag: person_.tags)
+    {
+        msg.add_tags(tag);
+    }
+    for(auto& entry: person_.logs)
+    {
+        auto log = msg.add_logs();
+        log->set_id(entry.id);
+        log->set_content(entry.content);
+        log->set_status(entry.status);
+        log->set_times(entry.times);
+    }
+    return msg;
+}
+
+std::string Pack::create_pb() const
+{
+    return create_msg().SerializeAsString();
+}
+
+std::string Pack::create_json() const
+{
+    JsonPrintOptions options;
+    options.preserve_proto_field_names = true;
+    options.always_print_primitive_fields = true;
+
+    std::string out;
+    MessageToJsonString(create_msg(), &out, options);
+    return out;
+}
+
+std::string Pack::create_json_gzip() const
+{
+    return gzip_compress(create_json(), 6);
+}
+
+std::size_t Pack::create_flat(std::string& out) const
+{
+    return flat::encode(person_, out);
+}
+
+std::size_t Pack::create_codec_pb(std::string& out) const
+{
+    out.resize(codec::pb_size(person_));
+    codec::pb_encode(person_, &out[0]);
+    return out.size();
+}
+
+std::size_t Pack::create_codec_json(std::string& out) const
+{
+    out.resize(codec::json_size(person_));
+    codec::json_encode(person_, &out[0]);
+    return out.size();
+}
+
+
+UnPack::UnPack(const std::string& project_path):
+    data_pb_(read_file(project_path + "/data.pb")),
+    data_json_(read_file(project_path + "/data.json")),
+    data_json_gzip_(read_file(project_path + "/data.json.gz")),
+    data_flat_(project_path + "/data.flat")
+{
+}
+
+Person UnPack::unpack_pb() const
+{
+    Person msg;
+    msg.ParseFromString(data_pb_);
+    return msg;
+}
+
+Person UnPack::unpack_json() const
+{
+    Person msg;
+    JsonStringToMessage(data_json_, &msg, JsonParseOptions());
+    return msg;
+}
+
+Person UnPack::unpack_json_gzip() const
+{
+    Person msg;
+    JsonStringToMessage(gzip_decompress(data_json_gzip_), &msg, JsonParseOptions());
+    return msg;
+}
+
+bool UnPack::unpack_codec_pb(codec::Person& out) const
+{
+    return codec::pb_decode(data_pb_.data(), data_pb_.size(), out);
+}
+
+bool UnPack::unpack_codec_json(codec::Person& out) const
+{
+    return codec::json_decode(data_json_.data(), data_json_.size(), out);
+}
+
+bool UnPack::unpack_simd_json(simd_json::Parser& parser, codec::Person& out) const
+{
+    return parser.parse(data_json_.data(), data_json_.size(), out);
+}
+
+flat::Person UnPack::unpack_flat(bool verify) const
+{
+    if(verify && !flat::verify(data_flat_.data(), data_flat_.size()))
+    {
+        return flat::Person(NULL);
+    }
+    return flat::Person(data_flat_.data());
+}
+
+bool UnPack::unpack_stream_json_gzip(codec::Person& out) const
+{
+    return gunzip_json_stream(data_json_gzip_.data(), data_json_gzip_.size(), out);
+}
+
+lazy::Person* UnPack::unpack_lazy_pb(Arena& arena) const
+{
+    return lazy::pb_decode(data_pb_.data(), data_pb_.size(), arena);
+}
+
+lazy::Person* UnPack::unpack_lazy_json(Arena& arena) const
+{
+    return lazy::json_decode(data_json_.data(), data_json_.size(), arena);
+}
+
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary);
+    if(!f)
+    {
+        std::cout << "can not open " << path << std::endl;
+        exit(1);
+    }
+
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+std::string project_path()
+{
+    // the executable lives in Cpp/, fixtures are one level up
+    char buf[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+    if(n <= 0)
+    {
+        return std::string("..");
+    }
+
+    std::string path(buf, n);
+    path = path.substr(0, path.rfind('/'));
+    return path.substr(0, path.rfind('/'));
+}
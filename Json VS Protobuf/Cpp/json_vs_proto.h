@@ -0,0 +1,86 @@
+#ifndef __JSON_VS_PROTO_H__
+#define __JSON_VS_PROTO_H__
+
+#include <string>
+#include <vector>
+
+#include "protocol.pb.h"
+#include "protocol_codec.h"
+#include "lazy_person.h"
+#include "simd_json.h"
+#include "flat_person.h"
+#include "mapped_file.h"
+
+
+// same data as Pack in Python/pack.py
+class Pack
+{
+public:
+    Pack(int log_amount);
+
+    std::string create_pb() const;
+    std::string create_json() const;
+    std::string create_json_gzip() const;
+
+    // generated codec (protocol_codec.h), encodes into `out`
+    // and reuses its storage, returns the encoded size
+    std::size_t create_codec_pb(std::string& out) const;
+    std::size_t create_codec_json(std::string& out) const;
+    // flat_person.h layout, same storage reuse
+    std::size_t create_flat(std::string& out) const;
+
+    static std::vector<int32_t> get_tags();
+    static std::vector<codec::Log> get_logs(int amount);
+
+private:
+    Person create_msg() const;
+
+    codec::Person person_;
+};
+
+
+// decodes data.pb, data.json and data.json.gz,
+// the files are read once in the constructor.
+// data.flat is mmap'd and read in place.
+class UnPack
+{
+public:
+    UnPack(const std::string& project_path);
+
+    Person unpack_pb() const;
+    Person unpack_json() const;
+    Person unpack_json_gzip() const;
+
+    bool unpack_codec_pb(codec::Person& out) const;
+    bool unpack_codec_json(codec::Person& out) const;
+    bool unpack_simd_json(simd_json::Parser& parser, codec::Person& out) const;
+    // data.json.gz inflated chunk by chunk into the streaming parser
+    bool unpack_stream_json_gzip(codec::Person& out) const;
+
+    // view over the mapped data.flat, verify() first if `verify`,
+    // an empty (false) view when that fails
+    flat::Person unpack_flat(bool verify) const;
+
+    // lazy::Person lives in `arena` and points into the fixture data
+    lazy::Person* unpack_lazy_pb(Arena& arena) const;
+    lazy::Person* unpack_lazy_json(Arena& arena) const;
+
+    const std::string& data_pb() const { return data_pb_; }
+    const std::string& data_json() const { return data_json_; }
+    const std::string& data_json_gzip() const { return data_json_gzip_; }
+    const MappedFile& data_flat() const { return data_flat_; }
+
+private:
+    std::string data_pb_;
+    std::string data_json_;
+    std::string data_json_gzip_;
+    MappedFile data_flat_;
+};
+
+
+std::string read_file(const std::string& path);
+
+// directory holding protocol.proto and the data.* fixtures
+std::string project_path();
+
+#endif // __JSON_VS_PROTO_H__
@@ -0,0 +1,303 @@
+#include "lazy_person.h"
+#include "protocol_codec.h"
+
+using codec::make_tag;
+using codec::read_varint;
+using codec::skip_field;
+using codec::JsonReader;
+using codec::WIRE_VARINT;
+using codec::WIRE_LENGTH;
+
+
+namespace lazy
+{
+
+namespace
+{
+
+bool in_input(std::string_view s, const char* begin, const char* end)
+{
+    return s.data() >= begin && s.data() < end;
+}
+
+// a json string, as a view into the input when it has no escapes
+bool read_json_string(JsonReader& r, Arena& arena, const char* begin, const char* end,
+        std::string_view& out)
+{
+    if(!r.read_string_view(out)) return false;
+    if(!out.empty() && !in_input(out, begin, end))
+    {
+        out = arena.copy(out);
+    }
+    return true;
+}
+
+bool pb_merge_log(const char* p, const char* end, Log& m)
+{
+    while(p < end)
+    {
+        uint64_t key;
+        uint64_t v;
+        if(!read_varint(p, end, key)) return false;
+
+        switch(key)
+        {
+        case make_tag(codec::Log_fields[0].number, WIRE_VARINT):
+            if(!read_varint(p, end, v)) return false;
+            m.id = static_cast<int32_t>(v);
+            break;
+        case codec::Log_fields[1].tag:
+            if(!read_varint(p, end, v) || v > static_cast<uint64_t>(end - p)) return false;
+            m.content = std::string_view(p, v);
+            p += v;
+            break;
+        case make_tag(codec::Log_fields[2].number, WIRE_VARINT):
+            if(!read_varint(p, end, v)) return false;
+            m.status = static_cast<int32_t>(v);
+            break;
+        case make_tag(codec::Log_fields[3].number, WIRE_VARINT):
+            if(!read_varint(p, end, v)) return false;
+            m.times = static_cast<int32_t>(v);
+            break;
+        default:
+            if(!skip_field(p, end, key & 7)) return false;
+        }
+    }
+    return true;
+}
+
+bool json_merge_log(JsonReader& r, Arena& arena, const char* begin, const char* end, Log& m)
+{
+    if(!r.begin_object()) return false;
+    if(r.end_object()) return true;
+
+    do
+    {
+        std::string_view key;
+        if(!r.read_key(key)) return false;
+        if(r.read_null()) continue;
+
+        if(key == codec::Log_fields[0].name)
+        {
+            if(!r.read_integer(m.id)) return false;
+        }
+        else if(key == codec::Log_fields[1].name)
+        {
+            if(!read_json_string(r, arena, begin, end, m.content)) return false;
+        }
+        else if(key == codec::Log_fields[2].name)
+        {
+            if(!r.read_integer(m.status)) return false;
+        }
+        else if(key == codec::Log_fields[3].name)
+        {
+            if(!r.read_integer(m.times)) return false;
+        }
+        else if(!r.skip_value())
+        {
+            return false;
+        }
+    } while(r.next_member());
+
+    return r.ok();
+}
+
+}
+
+
+Span<int32_t> Person::tags()
+{
+    if(tags_done_ || !tags_at_)
+    {
+        return tags_;
+    }
+    tags_done_ = true;
+
+    ArenaArray<int32_t> tags(*arena_, tags_hint_);
+    if(format_ == PB)
+    {
+        const char* p = tags_at_;
+        while(p < end_)
+        {
+            uint64_t key;
+            uint64_t v;
+            if(!read_varint(p, end_, key)) break;
+
+            if(key == make_tag(codec::Person_fields[2].number, WIRE_VARINT))
+            {
+                if(!read_varint(p, end_, v)) break;
+                tags.push_back(static_cast<int32_t>(v));
+            }
+            else if(key == make_tag(codec::Person_fields[2].number, WIRE_LENGTH))
+            {
+                if(!read_varint(p, end_, v) || v > static_cast<uint64_t>(end_ - p)) break;
+                const char* stop = p + v;
+                while(p < stop && read_varint(p, stop, v))
+                {
+                    tags.push_back(static_cast<int32_t>(v));
+                }
+            }
+            else if(!skip_field(p, end_, key & 7))
+            {
+                break;
+            }
+        }
+        error_ = error_ || p != end_;
+    }
+    else
+    {
+        JsonReader r(tags_at_, end_);
+        if(r.begin_array() && !r.end_array())
+        {
+            do
+            {
+                int32_t v;
+                if(!r.read_integer(v)) break;
+                tags.push_back(v);
+            } while(r.next_element());
+        }
+        error_ = error_ || !r.ok();
+    }
+
+    tags_ = tags.span();
+    return tags_;
+}
+
+Span<Log> Person::logs()
+{
+    if(logs_done_ || !logs_at_)
+    {
+        return logs_;
+    }
+    logs_done_ = true;
+
+    ArenaArray<Log> logs(*arena_, logs_hint_);
+    if(format_ == PB)
+    {
+        const char* p = logs_at_;
+        while(p < end_)
+        {
+            uint64_t key;
+            if(!read_varint(p, end_, key)) break;
+
+            if(key == codec::Person_fields[3].tag)
+            {
+                // framing was checked by pb_decode
+                uint64_t n = 0;
+                read_varint(p, end_, n);
+                if(!pb_merge_log(p, p + n, logs.emplace_back()))
+                {
+                    error_ = true;
+                }
+                p += n;
+            }
+            else if(!skip_field(p, end_, key & 7))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        JsonReader r(logs_at_, end_);
+        if(r.begin_array() && !r.end_array())
+        {
+            do
+            {
+                if(!json_merge_log(r, *arena_, begin_, end_, logs.emplace_back())) break;
+            } while(r.next_element());
+        }
+        error_ = error_ || !r.ok();
+    }
+
+    logs_ = logs.span();
+    return logs_;
+}
+
+
+Person* pb_decode(const char* data, std::size_t size, Arena& arena)
+{
+    const char* p = data;
+    const char* end = data + size;
+    Person* m = arena.make<Person>(arena, Person::PB, data, end);
+
+    while(p < end)
+    {
+        const char* field = p;
+        uint64_t key;
+        uint64_t v;
+        if(!read_varint(p, end, key)) return NULL;
+
+        switch(key)
+        {
+        case make_tag(codec::Person_fields[0].number, WIRE_VARINT):
+            if(!read_varint(p, end, v)) return NULL;
+            m->id = static_cast<int32_t>(v);
+            break;
+        case codec::Person_fields[1].tag:
+            if(!read_varint(p, end, v) || v > static_cast<uint64_t>(end - p)) return NULL;
+            m->name = std::string_view(p, v);
+            p += v;
+            break;
+        case make_tag(codec::Person_fields[2].number, WIRE_VARINT):
+        case make_tag(codec::Person_fields[2].number, WIRE_LENGTH):
+            if(!m->tags_at_) m->tags_at_ = field;
+            m->tags_hint_++;
+            if(!skip_field(p, end, key & 7)) return NULL;
+            break;
+        case codec::Person_fields[3].tag:
+            if(!m->logs_at_) m->logs_at_ = field;
+            m->logs_hint_++;
+            if(!skip_field(p, end, key & 7)) return NULL;
+            break;
+        default:
+            if(!skip_field(p, end, key & 7)) return NULL;
+        }
+    }
+    return m;
+}
+
+Person* json_decode(const char* data, std::size_t size, Arena& arena)
+{
+    const char* end = data + size;
+    Person* m = arena.make<Person>(arena, Person::JSON, data, end);
+
+    JsonReader r(data, end);
+    if(!r.begin_object()) return NULL;
+    if(r.end_object()) return r.at_end() ? m : NULL;
+
+    do
+    {
+        std::string_view key;
+        if(!r.read_key(key)) return NULL;
+        if(r.read_null()) continue;
+
+        if(key == codec::Person_fields[0].name)
+        {
+            if(!r.read_integer(m->id)) return NULL;
+        }
+        else if(key == codec::Person_fields[1].name)
+        {
+            if(!read_json_string(r, arena, data, end, m->name)) return NULL;
+        }
+        else if(key == codec::Person_fields[2].name)
+        {
+            // only remember where the array is, tags() parses it
+            m->tags_at_ = r.position();
+            if(!r.skip_value()) return NULL;
+        }
+        else if(key == codec::Person_fields[3].name)
+        {
+            m->logs_at_ = r.position();
+            if(!r.skip_value()) return NULL;
+        }
+        else if(!r.skip_value())
+        {
+            return NULL;
+        }
+    } while(r.next_member());
+
+    return r.at_end() ? m : NULL;
+}
+
+}
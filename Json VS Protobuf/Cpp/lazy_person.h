@@ -0,0 +1,83 @@
+#ifndef __LAZY_PERSON_H__
+#define __LAZY_PERSON_H__
+
+#include <cstdint>
+#include <string_view>
+
+#include "arena.h"
+
+// Person decoded into an Arena.
+//
+// strings are views into the input buffer (json strings with escapes
+// are unescaped into the arena), repeated fields are only decoded on
+// first access. the input buffer must outlive the decoded message,
+// and Arena::reset() frees all of it at once.
+namespace lazy
+{
+
+struct Log
+{
+    int32_t id;
+    std::string_view content;
+    int32_t status;
+    int32_t times;
+};
+
+class Person
+{
+public:
+    enum Format
+    {
+        PB,
+        JSON,
+    };
+
+    Person(Arena& arena, Format format, const char* begin, const char* end):
+        id(0), arena_(&arena), format_(format), begin_(begin), end_(end),
+        tags_at_(NULL), logs_at_(NULL), tags_hint_(0), logs_hint_(0),
+        tags_{NULL, 0}, logs_{NULL, 0},
+        tags_done_(false), logs_done_(false), error_(false)
+    {}
+
+    int32_t id;
+    std::string_view name;
+
+    Span<int32_t> tags();
+    Span<Log> logs();
+
+    // false if a lazily decoded field turned out to be malformed
+    bool ok() const
+    {
+        return !error_;
+    }
+
+private:
+    friend Person* pb_decode(const char*, std::size_t, Arena&);
+    friend Person* json_decode(const char*, std::size_t, Arena&);
+
+    Arena* arena_;
+    Format format_;
+    const char* begin_;
+    const char* end_;
+
+    // where the field was first seen by the eager pass
+    const char* tags_at_;
+    const char* logs_at_;
+    // element count seen by the eager pass, to size the arrays
+    std::size_t tags_hint_;
+    std::size_t logs_hint_;
+
+    Span<int32_t> tags_;
+    Span<Log> logs_;
+    bool tags_done_;
+    bool logs_done_;
+    bool error_;
+};
+
+// NULL if the message framing is invalid
+Person* pb_decode(const char* data, std::size_t size, Arena& arena);
+Person* json_decode(const char* data, std::size_t size, Arena& arena);
+
+}
+
+#endif // __LAZY_PERSON_H__
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped_file.h"
+
+
+MappedFile::MappedFile(const std::string& path):
+    data_(NULL), size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0)
+    {
+        std::cout << "can not open " << path << std::endl;
+        exit(1);
+    }
+
+    size_ = st.st_size;
+    if(size_)
+    {
+        void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            std::cout << "can not mmap " << path << std::endl;
+            exit(1);
+        }
+        data_ = static_cast<const char*>(p);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if(data_)
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+void MappedFile::advise(int advice, std::size_t offset, std::size_t size) const
+{
+    if(!data_ || offset >= size_) return;
+
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t begin = offset / page * page;
+    std::size_t end = size > size_ - offset ? size_ : offset + size;
+    madvise(const_cast<char*>(data_) + begin, end - begin, advice);
+}
@@ -0,0 +1,37 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+// read only mmap of a whole file, page aligned.
+// like read_file(), exits if the file can not be opened.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    // madvise() on [offset, offset + size), clipped to the file.
+    // offset is rounded down to a page. only a hint, errors are ignored.
+    void advise(int advice, std::size_t offset = 0, std::size_t size = std::string::npos) const;
+
+private:
+    const char* data_;
+    std::size_t size_;
+};
+
+#endif // __MAPPED_FILE_H__
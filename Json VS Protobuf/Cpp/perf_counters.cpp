@@ -0,0 +1,102 @@
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf_counters.h"
+
+
+namespace
+{
+
+int open_counter(uint64_t config, int group)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this thread, any cpu
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+}
+
+
+PerfCounters::PerfCounters()
+{
+    static const uint64_t configs[COUNT] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    // one group, so all of them count over exactly the same interval
+    for(int i=0; i<COUNT; i++)
+    {
+        fd_[i] = open_counter(configs[i], i == 0 ? -1 : fd_[0]);
+        if(fd_[i] < 0)
+        {
+            for(int j=0; j<i; j++)
+            {
+                close(fd_[j]);
+                fd_[j] = -1;
+            }
+            for(int j=i; j<COUNT; j++)
+            {
+                fd_[j] = -1;
+            }
+            break;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for(int i=0; i<COUNT; i++)
+    {
+        if(fd_[i] >= 0) close(fd_[i]);
+    }
+}
+
+void PerfCounters::start()
+{
+    if(!available()) return;
+    ioctl(fd_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::stop()
+{
+    if(!available()) return;
+    ioctl(fd_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+uint64_t PerfCounters::read(Counter c) const
+{
+    uint64_t v = 0;
+    if(!available() || ::read(fd_[c], &v, sizeof(v)) != sizeof(v))
+    {
+        return 0;
+    }
+    return v;
+}
+
+const char* PerfCounters::name(Counter c)
+{
+    switch(c)
+    {
+    case CYCLES: return "cycles";
+    case INSTRUCTIONS: return "instructions";
+    case CACHE_MISSES: return "cache_misses";
+    case BRANCH_MISSES: return "branch_misses";
+    default: return "";
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <cstdint>
+
+// hardware counters of the calling thread through perf_event_open.
+// often not permitted (containers, perf_event_paranoid), then
+// available() is false and every read gives 0.
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        COUNT,
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const
+    {
+        return fd_[0] >= 0;
+    }
+
+    // zero and start every counter
+    void start();
+    void stop();
+
+    uint64_t read(Counter c) const;
+
+    static const char* name(Counter c);
+
+private:
+    int fd_[COUNT];
+};
+
+#endif // __PERF_COUNTERS_H__
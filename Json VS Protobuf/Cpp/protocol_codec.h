@@ -0,0 +1,426 @@
+// Generated by gen_codec.py from protocol.proto, do not edit.
+#ifndef __PROTOCOL_CODEC_H__
+#define __PROTOCOL_CODEC_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "codec_runtime.h"
+#include "varint_batch.h"
+
+namespace codec
+{
+
+struct Log
+{
+    int32_t id = 0;
+    std::string content;
+    int32_t status = 0;
+    int32_t times = 0;
+};
+
+constexpr FieldInfo Log_fields[] =
+{
+    make_field(1, WIRE_VARINT, false, false, "id", "\"id\":"),
+    make_field(2, WIRE_LENGTH, false, false, "content", "\"content\":"),
+    make_field(3, WIRE_VARINT, false, false, "status", "\"status\":"),
+    make_field(4, WIRE_VARINT, false, false, "times", "\"times\":"),
+};
+
+inline void clear(Log& m)
+{
+    m.id = 0;
+    m.content.clear();
+    m.status = 0;
+    m.times = 0;
+}
+
+inline std::size_t pb_size(const Log& m)
+{
+    std::size_t size = 0;
+    size += Log_fields[0].tag_size + varint_size(static_cast<uint64_t>(static_cast<int64_t>(m.id)));
+    size += Log_fields[1].tag_size + varint_size(m.content.size()) + m.content.size();
+    size += Log_fields[2].tag_size + varint_size(static_cast<uint64_t>(static_cast<int64_t>(m.status)));
+    size += Log_fields[3].tag_size + varint_size(static_cast<uint64_t>(static_cast<int64_t>(m.times)));
+    return size;
+}
+
+inline char* pb_encode(const Log& m, char* p)
+{
+    p = write_varint(p, Log_fields[0].tag);
+    p = write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(m.id)));
+    p = write_varint(p, Log_fields[1].tag);
+    p = write_varint(p, m.content.size());
+    std::memcpy(p, m.content.data(), m.content.size());
+    p += m.content.size();
+    p = write_varint(p, Log_fields[2].tag);
+    p = write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(m.status)));
+    p = write_varint(p, Log_fields[3].tag);
+    p = write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(m.times)));
+    return p;
+}
+
+inline bool pb_merge(const char* p, const char* end, Log& m)
+{
+    while(p < end)
+    {
+        uint64_t key;
+        if(!read_varint(p, end, key)) return false;
+
+        switch(key)
+        {
+            case make_tag(Log_fields[0].number, WIRE_VARINT):
+            {
+                uint64_t v;
+                if(!read_varint(p, end, v)) return false;
+                m.id = static_cast<int32_t>(v);
+                break;
+            }
+            case Log_fields[1].tag:
+            {
+                uint64_t n;
+                if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;
+                m.content.assign(p, n);
+                p += n;
+                break;
+            }
+            case make_tag(Log_fields[2].number, WIRE_VARINT):
+            {
+                uint64_t v;
+                if(!read_varint(p, end, v)) return false;
+                m.status = static_cast<int32_t>(v);
+                break;
+            }
+            case make_tag(Log_fields[3].number, WIRE_VARINT):
+            {
+                uint64_t v;
+                if(!read_varint(p, end, v)) return false;
+                m.times = static_cast<int32_t>(v);
+                break;
+            }
+            default:
+                if(!skip_field(p, end, key & 7)) return false;
+        }
+    }
+    return true;
+}
+
+inline std::size_t json_size(const Log& m)
+{
+    std::size_t size = 2 + 3;
+    size += Log_fields[0].json_key.size();
+    size += decimal_size(static_cast<int64_t>(m.id));
+    size += Log_fields[1].json_key.size();
+    size += json_string_size(m.content);
+    size += Log_fields[2].json_key.size();
+    size += decimal_size(static_cast<int64_t>(m.status));
+    size += Log_fields[3].json_key.size();
+    size += decimal_size(static_cast<int64_t>(m.times));
+    return size;
+}
+
+inline char* json_encode(const Log& m, char* p)
+{
+    *p++ = '{';
+    p = write_raw(p, Log_fields[0].json_key);
+    p = write_decimal(p, static_cast<int64_t>(m.id));
+    *p++ = ',';
+    p = write_raw(p, Log_fields[1].json_key);
+    p = write_json_string(p, m.content);
+    *p++ = ',';
+    p = write_raw(p, Log_fields[2].json_key);
+    p = write_decimal(p, static_cast<int64_t>(m.status));
+    *p++ = ',';
+    p = write_raw(p, Log_fields[3].json_key);
+    p = write_decimal(p, static_cast<int64_t>(m.times));
+    *p++ = '}';
+    return p;
+}
+
+template<class Reader>
+inline bool json_merge(Reader& r, Log& m)
+{
+    if(!r.begin_object()) return false;
+    if(r.end_object()) return true;
+
+    do
+    {
+        std::string_view key;
+        if(!r.read_key(key)) return false;
+        if(r.read_null()) continue;
+
+        if(key == Log_fields[0].name)
+        {
+            if(!r.read_integer(m.id)) return false;
+        }
+        else if(key == Log_fields[1].name)
+        {
+            if(!r.read_string(m.content)) return false;
+        }
+        else if(key == Log_fields[2].name)
+        {
+            if(!r.read_integer(m.status)) return false;
+        }
+        else if(key == Log_fields[3].name)
+        {
+            if(!r.read_integer(m.times)) return false;
+        }
+        else if(!r.skip_value())
+        {
+            return false;
+        }
+    } while(r.next_member());
+
+    return r.ok();
+}
+
+inline bool pb_decode(const char* data, std::size_t size, Log& m)
+{
+    clear(m);
+    return pb_merge(data, data + size, m);
+}
+
+inline bool json_decode(const char* data, std::size_t size, Log& m)
+{
+    JsonReader r(data, data + size);
+    clear(m);
+    return json_merge(r, m) && r.at_end();
+}
+
+struct Person
+{
+    int32_t id = 0;
+    std::string name;
+    std::vector<int32_t> tags;
+    std::vector<Log> logs;
+};
+
+constexpr FieldInfo Person_fields[] =
+{
+    make_field(1, WIRE_VARINT, false, false, "id", "\"id\":"),
+    make_field(2, WIRE_LENGTH, false, false, "name", "\"name\":"),
+    make_field(3, WIRE_VARINT, true, false, "tags", "\"tags\":"),
+    make_field(4, WIRE_LENGTH, true, false, "logs", "\"logs\":"),
+};
+
+inline void clear(Person& m)
+{
+    m.id = 0;
+    m.name.clear();
+    m.tags.clear();
+    m.logs.clear();
+}
+
+inline std::size_t pb_size(const Person& m)
+{
+    std::size_t size = 0;
+    size += Person_fields[0].tag_size + varint_size(static_cast<uint64_t>(static_cast<int64_t>(m.id)));
+    size += Person_fields[1].tag_size + varint_size(m.name.size()) + m.name.size();
+    for(auto v: m.tags) size += Person_fields[2].tag_size + varint_size(static_cast<uint64_t>(static_cast<int64_t>(v)));
+    for(auto& v: m.logs)
+    {
+        std::size_t n = pb_size(v);
+        size += Person_fields[3].tag_size + varint_size(n) + n;
+    }
+    return size;
+}
+
+inline char* pb_encode(const Person& m, char* p)
+{
+    p = write_varint(p, Person_fields[0].tag);
+    p = write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(m.id)));
+    p = write_varint(p, Person_fields[1].tag);
+    p = write_varint(p, m.name.size());
+    std::memcpy(p, m.name.data(), m.name.size());
+    p += m.name.size();
+    for(auto v: m.tags)
+    {
+        p = write_varint(p, Person_fields[2].tag);
+        p = write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(v)));
+    }
+    for(auto& v: m.logs)
+    {
+        p = write_varint(p, Person_fields[3].tag);
+        p = write_varint(p, pb_size(v));
+        p = pb_encode(v, p);
+    }
+    return p;
+}
+
+inline bool pb_merge(const char* p, const char* end, Person& m)
+{
+    while(p < end)
+    {
+        uint64_t key;
+        if(!read_varint(p, end, key)) return false;
+
+        switch(key)
+        {
+            case make_tag(Person_fields[0].number, WIRE_VARINT):
+            {
+                uint64_t v;
+                if(!read_varint(p, end, v)) return false;
+                m.id = static_cast<int32_t>(v);
+                break;
+            }
+            case Person_fields[1].tag:
+            {
+                uint64_t n;
+                if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;
+                m.name.assign(p, n);
+                p += n;
+                break;
+            }
+            case make_tag(Person_fields[2].number, WIRE_VARINT):
+            {
+                uint64_t v;
+                if(!read_varint(p, end, v)) return false;
+                m.tags.push_back(static_cast<int32_t>(v));
+                p = varint::append_tagged_int32(p, end, static_cast<uint8_t>(key), m.tags);
+                if(!p) return false;
+                break;
+            }
+            case make_tag(Person_fields[2].number, WIRE_LENGTH):
+            {
+                uint64_t n;
+                if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;
+                const char* stop = p + n;
+                if(!varint::append_int32(p, stop, m.tags)) return false;
+                p = stop;
+                break;
+            }
+            case Person_fields[3].tag:
+            {
+                uint64_t n;
+                if(!read_varint(p, end, n) || n > static_cast<uint64_t>(end - p)) return false;
+                m.logs.emplace_back();
+                if(!pb_merge(p, p + n, m.logs.back())) return false;
+                p += n;
+                break;
+            }
+            default:
+                if(!skip_field(p, end, key & 7)) return false;
+        }
+    }
+    return true;
+}
+
+inline std::size_t json_size(const Person& m)
+{
+    std::size_t size = 2 + 3;
+    size += Person_fields[0].json_key.size();
+    size += decimal_size(static_cast<int64_t>(m.id));
+    size += Person_fields[1].json_key.size();
+    size += json_string_size(m.name);
+    size += Person_fields[2].json_key.size();
+    size += 2 + (m.tags.empty() ? 0 : m.tags.size() - 1);
+    for(auto& v: m.tags) size += decimal_size(static_cast<int64_t>(v));
+    size += Person_fields[3].json_key.size();
+    size += 2 + (m.logs.empty() ? 0 : m.logs.size() - 1);
+    for(auto& v: m.logs) size += json_size(v);
+    return size;
+}
+
+inline char* json_encode(const Person& m, char* p)
+{
+    *p++ = '{';
+    p = write_raw(p, Person_fields[0].json_key);
+    p = write_decimal(p, static_cast<int64_t>(m.id));
+    *p++ = ',';
+    p = write_raw(p, Person_fields[1].json_key);
+    p = write_json_string(p, m.name);
+    *p++ = ',';
+    p = write_raw(p, Person_fields[2].json_key);
+    *p++ = '[';
+    for(std::size_t i=0; i<m.tags.size(); i++)
+    {
+        if(i) *p++ = ',';
+        p = write_decimal(p, static_cast<int64_t>(m.tags[i]));
+    }
+    *p++ = ']';
+    *p++ = ',';
+    p = write_raw(p, Person_fields[3].json_key);
+    *p++ = '[';
+    for(std::size_t i=0; i<m.logs.size(); i++)
+    {
+        if(i) *p++ = ',';
+        p = json_encode(m.logs[i], p);
+    }
+    *p++ = ']';
+    *p++ = '}';
+    return p;
+}
+
+template<class Reader>
+inline bool json_merge(Reader& r, Person& m)
+{
+    if(!r.begin_object()) return false;
+    if(r.end_object()) return true;
+
+    do
+    {
+        std::string_view key;
+        if(!r.read_key(key)) return false;
+        if(r.read_null()) continue;
+
+        if(key == Person_fields[0].name)
+        {
+            if(!r.read_integer(m.id)) return false;
+        }
+        else if(key == Person_fields[1].name)
+        {
+            if(!r.read_string(m.name)) return false;
+        }
+        else if(key == Person_fields[2].name)
+        {
+            if(!r.begin_array()) return false;
+            if(!r.end_array())
+            {
+                do
+                {
+                    int32_t v;
+                    if(!r.read_integer(v)) return false;
+                    m.tags.push_back(v);
+                } while(r.next_element());
+                if(!r.ok()) return false;
+            }
+        }
+        else if(key == Person_fields[3].name)
+        {
+            if(!r.begin_array()) return false;
+            if(!r.end_array())
+            {
+                do
+                {
+                    m.logs.emplace_back();
+                    if(!json_merge(r, m.logs.back())) return false;
+                } while(r.next_element());
+                if(!r.ok()) return false;
+            }
+        }
+        else if(!r.skip_value())
+        {
+            return false;
+        }
+    } while(r.next_member());
+
+    return r.ok();
+}
+
+inline bool pb_decode(const char* data, std::size_t size, Person& m)
+{
+    clear(m);
+    return pb_merge(data, data + size, m);
+}
+
+inline bool json_decode(const char* data, std::size_t size, Person& m)
+{
+    JsonReader r(data, data + size);
+    clear(m);
+    return json_merge(r, m) && r.at_end();
+}
+
+}
+
+#endif // __PROTOCOL_CODEC_H__
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+#include "records.h"
+
+
+namespace records
+{
+
+namespace
+{
+
+// hands out chunks of the file that end on a record boundary
+class Splitter
+{
+public:
+    Splitter(const MappedFile& file, Format f, std::size_t chunk_size, std::size_t prefetch):
+        file_(file), format_(f), chunk_size_(chunk_size), prefetch_(prefetch),
+        cursor_(file.data()), end_(file.data() + file.size()), prefetched_(0), errors_(0)
+    {
+        file_.advise(MADV_SEQUENTIAL);
+        advance_prefetch(0);
+    }
+
+    bool next(const char*& begin, const char*& end)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(cursor_ == end_) return false;
+
+        begin = cursor_;
+        end = format_ == PROTOBUF ? split_pb(cursor_) : split_lines(cursor_);
+        // nothing after a broken prefix can be found again
+        cursor_ = errors_ ? end_ : end;
+
+        advance_prefetch(cursor_ - file_.data());
+        return begin != end;
+    }
+
+    std::size_t errors() const
+    {
+        return errors_;
+    }
+
+private:
+    const char* split_pb(const char* p)
+    {
+        const char* start = p;
+        while(p < end_ && static_cast<std::size_t>(p - start) < chunk_size_)
+        {
+            const char* record = p;
+            uint64_t size;
+            if(!codec::read_varint(p, end_, size) || size > static_cast<uint64_t>(end_ - p))
+            {
+                errors_++;
+                return record;
+            }
+            p += size;
+        }
+        return p;
+    }
+
+    const char* split_lines(const char* p)
+    {
+        if(static_cast<std::size_t>(end_ - p) <= chunk_size_) return end_;
+
+        auto nl = static_cast<const char*>(std::memchr(p + chunk_size_, '\n', end_ - p - chunk_size_));
+        return nl ? nl + 1 : end_;
+    }
+
+    // keep the kernel reading `prefetch_` bytes ahead of the cursor
+    void advance_prefetch(std::size_t offset)
+    {
+        std::size_t target = offset + prefetch_;
+        if(prefetched_ >= file_.size() || target < prefetched_ + prefetch_ / 4) return;
+
+        std::size_t from = std::max(prefetched_, offset);
+        file_.advise(MADV_WILLNEED, from, target - from);
+        prefetched_ = target;
+    }
+
+    const MappedFile& file_;
+    Format format_;
+    std::size_t chunk_size_;
+    std::size_t prefetch_;
+
+    std::mutex mutex_;
+    const char* cursor_;
+    const char* end_;
+    std::size_t prefetched_;
+    std::size_t errors_;
+};
+
+void add(Stats& stats, const codec::Person& person)
+{
+    stats.records++;
+    for(auto& log: person.logs)
+    {
+        stats.checksum += log.times;
+    }
+}
+
+void decode_chunk(const char* p, const char* end, Format f, codec::Person& person, Stats& stats)
+{
+    while(p < end)
+    {
+        const char* record;
+        std::size_t size;
+        if(f == PROTOBUF)
+        {
+            // the splitter checked the prefixes
+            uint64_t n = 0;
+            codec::read_varint(p, end, n);
+            record = p;
+            size = static_cast<std::size_t>(n);
+            p += size;
+        }
+        else
+        {
+            auto nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            record = p;
+            size = (nl ? nl : end) - p;
+            p = nl ? nl + 1 : end;
+            if(size == 0) continue;
+        }
+
+        bool ok = f == PROTOBUF ? codec::pb_decode(record, size, person) : codec::json_decode(record, size, person);
+        if(ok) add(stats, person);
+        else stats.errors++;
+    }
+}
+
+}
+
+
+const char* format_name(Format f)
+{
+    return f == PROTOBUF ? "Protobuf" : "Ndjson";
+}
+
+bool write_file(const std::string& path, Format f, std::size_t count, const codec::Person& person)
+{
+    std::ofstream out(path, std::ios::binary);
+    if(!out) return false;
+
+    const std::size_t flush_size = 1 << 20;
+    codec::Person m = person;
+    std::string buffer;
+    buffer.reserve(flush_size * 2);
+
+    for(std::size_t i=0; i<count; i++)
+    {
+        m.id = person.id + static_cast<int32_t>(i);
+
+        std::size_t at = buffer.size();
+        if(f == PROTOBUF)
+        {
+            std::size_t size = codec::pb_size(m);
+            char prefix[10];
+            buffer.append(prefix, codec::write_varint(prefix, size) - prefix);
+            at = buffer.size();
+            buffer.resize(at + size);
+            codec::pb_encode(m, &buffer[at]);
+        }
+        else
+        {
+            buffer.resize(at + codec::json_size(m));
+            char* end = codec::json_encode(m, &buffer[at]);
+            buffer.resize(end - buffer.data());
+            buffer += '\n';
+        }
+
+        if(buffer.size() >= flush_size)
+        {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    return static_cast<bool>(out);
+}
+
+Stats decode_file(const MappedFile& file, Format f, int threads, std::size_t chunk_size, std::size_t prefetch)
+{
+    Splitter splitter(file, f, chunk_size, prefetch);
+    std::vector<Stats> stats(threads, Stats());
+
+    auto worker = [&splitter, f](Stats& s)
+    {
+        codec::Person person;
+        const char* begin;
+        const char* end;
+        while(splitter.next(begin, end))
+        {
+            decode_chunk(begin, end, f, person, s);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int i=0; i<threads; i++)
+    {
+        pool.emplace_back(worker, std::ref(stats[i]));
+    }
+    for(auto& t: pool)
+    {
+        t.join();
+    }
+
+    Stats total = Stats();
+    for(auto& s: stats)
+    {
+        total.records += s.records;
+        total.errors += s.errors;
+        total.checksum += s.checksum;
+    }
+    total.errors += splitter.errors();
+    return total;
+}
+
+}
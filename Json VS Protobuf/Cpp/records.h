@@ -0,0 +1,49 @@
+#ifndef __RECORDS_H__
+#define __RECORDS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "protocol_codec.h"
+#include "mapped_file.h"
+
+// files of many Person records, the shape of log ingest data:
+//   PROTOBUF  length delimited, a varint size before every message
+//             (what writeDelimitedTo / parseDelimitedFrom use)
+//   NDJSON    one json object per line
+namespace records
+{
+
+enum Format
+{
+    PROTOBUF,
+    NDJSON,
+};
+
+const char* format_name(Format f);
+
+// `count` copies of `person` with ids counting up from person.id,
+// false if the file can not be written
+bool write_file(const std::string& path, Format f, std::size_t count, const codec::Person& person);
+
+
+struct Stats
+{
+    std::size_t records;
+    std::size_t errors;
+    // sum of every log's times, so the decoding can not be skipped
+    int64_t checksum;
+};
+
+// decodes every record of `file` on `threads` threads.
+// the file is handed out in chunks of about `chunk_size` bytes that end
+// on a record boundary; each chunk claimed asks the kernel to read
+// `prefetch` more bytes ahead. a broken length prefix counts as one
+// error and ends the file.
+Stats decode_file(const MappedFile& file, Format f, int threads,
+        std::size_t chunk_size = 1 << 20, std::size_t prefetch = 16 << 20);
+
+}
+
+#endif // __RECORDS_H__
@@ -0,0 +1,206 @@
+#!/usr/bin/env python
+"""
+Turn the json written by `./benchmark harness` into the README tables.
+
+    ./benchmark harness 30 results.json
+    ./report.py results.json [MORE RESULTS ...] [--chart ../chart.png]
+
+Prints, in the layout of the README:
+
+    the size table (of the first results file)
+    the pack / unpack time tables, one row per results file (language),
+    as seconds for 5000 runs with 100 logs, from the median sample
+    a detail table per file: median, 95% CI of the median, p95,
+    allocations and bytes per op, and hardware counters if recorded
+
+--chart draws the pack / unpack chart (needs matplotlib).
+"""
+from __future__ import print_function
+
+import json
+import sys
+
+
+README_TIMES = 5000
+FORMATS = ['Protobuf', 'Json', 'Json GZip']
+SIZE_COLUMNS = [
+    ('Protobuf', 'Protobuf'),
+    ('Protobuf GZip', 'Protobuf with GZip'),
+    ('Json', 'Json'),
+    ('Json GZip', 'Json with GZip'),
+    ('Protobuf Dict', 'Protobuf with Dict'),
+    ('Json Dict', 'Json with Dict'),
+]
+
+
+def table(header, rows, first_left=True):
+    """ascii table with a rule after every row, like the README"""
+    widths = [max(len(str(c)) for c in col) + 4 for col in zip(header, *rows)]
+
+    def line(cells):
+        out = []
+        for i, (cell, width) in enumerate(zip(cells, widths)):
+            cell = str(cell)
+            if i == 0 and first_left:
+                out.append(' ' + cell.ljust(width - 1))
+            else:
+                out.append(cell.center(width))
+        return '|' + '|'.join(out) + '|'
+
+    rule = '+' + '+'.join('-' * w for w in widths) + '+'
+    lines = [rule, line(header), rule]
+    for row in rows:
+        lines.append(line(row))
+        lines.append(rule)
+    return '\n'.join(lines)
+
+
+def find(results, group, name):
+    for r in results['results']:
+        if r['group'] == group and r['name'] == name:
+            return r
+    return None
+
+
+def readme_seconds(results, group, name):
+    r = find(results, group, name)
+    if r is None:
+        return None
+    return r['ns']['median'] * README_TIMES / 1e9
+
+
+def size_table(results):
+    header = ['Logs'] + [title for _, title in SIZE_COLUMNS]
+    rows = []
+    for row in results['sizes']:
+        rows.append([row['logs']] + [row.get(key, '-') for key, _ in SIZE_COLUMNS])
+    return table(header, rows, first_left=False)
+
+
+def time_table(all_results, group):
+    rows = []
+    for results in all_results:
+        row = [results['language']]
+        for name in FORMATS:
+            seconds = readme_seconds(results, group, name)
+            row.append('-' if seconds is None else '%.2f' % seconds)
+        rows.append(row)
+    return table(['Language', 'Protobuf', 'Json', 'Json with GZip'], rows)
+
+
+def number(v, fmt='%.1f'):
+    return '-' if v is None else fmt % v
+
+
+def detail_table(results):
+    counters = ['cycles', 'instructions', 'cache_misses', 'branch_misses']
+    with_perf = any(r.get('cycles_per_op') is not None for r in results['results'])
+
+    header = ['Case', 'Median ns', '95% CI', 'p95 ns', 'Allocs/Op', 'Bytes/Op']
+    if with_perf:
+        header += [c.replace('_', ' ').title() + '/Op' for c in counters]
+
+    rows = []
+    for r in results['results']:
+        ns = r['ns']
+        row = [
+            '%s %s' % (r['group'], r['name']),
+            number(ns['median']),
+            '%s - %s' % (number(ns['ci95'][0]), number(ns['ci95'][1])),
+            number(ns['p95']),
+            number(r['allocs_per_op'], '%.2f'),
+            number(r['bytes_per_op'], '%.0f'),
+        ]
+        if with_perf:
+            row += [number(r.get(c + '_per_op'), '%.0f') for c in counters]
+        rows.append(row)
+    return table(header, rows)
+
+
+def draw_chart(all_results, path):
+    """same layout as chart.png: serialize and deserialize groups with a
+    bar per language and format, error bars are the 95% CI of the median"""
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("--chart needs matplotlib")
+        sys.exit(1)
+
+    bars = [(r, name) for name in FORMATS for r in all_results]
+    width = 0.8 / len(bars)
+    fig, ax = plt.subplots(figsize=(11, 8))
+
+    for i, (results, name) in enumerate(bars):
+        xs, values, errors = [], [], [[], []]
+        for x, group in enumerate(['pack', 'unpack']):
+            r = find(results, group, name)
+            if r is None:
+                continue
+            scale = README_TIMES / 1e9
+            median = r['ns']['median'] * scale
+            xs.append(x + (i - (len(bars) - 1) / 2.0) * width)
+            values.append(median)
+            errors[0].append(median - r['ns']['ci95'][0] * scale)
+            errors[1].append(r['ns']['ci95'][1] * scale - median)
+
+        label = '%s-%s' % (results['language'], name.replace(' ', ''))
+        ax.bar(xs, values, width, yerr=errors, capsize=2, label=label)
+        for x, v in zip(xs, values):
+            ax.text(x, v, '%.2f' % v, ha='center', va='bottom', fontsize=8)
+
+    ax.set_title('Serialize/Deserialize Speed (%d times)' % README_TIMES)
+    ax.set_ylabel('Seconds')
+    ax.set_xticks([0, 1])
+    ax.set_xticklabels(['Serialize', 'Deserialize'])
+    ax.yaxis.grid(True)
+    ax.legend(ncol=3, loc='upper center', bbox_to_anchor=(0.5, -0.06))
+
+    fig.tight_layout()
+    fig.savefig(path)
+
+
+def main():
+    args = sys.argv[1:]
+    chart = None
+    if '--chart' in args:
+        i = args.index('--chart')
+        if i + 1 >= len(args):
+            args = []
+        else:
+            chart = args[i + 1]
+            del args[i:i + 2]
+
+    if not args:
+        print("usage: ./report.py [RESULTS FILE] [MORE RESULTS ...] [--chart PNG]")
+        sys.exit(1)
+
+    all_results = []
+    for path in args:
+        with open(path) as f:
+            all_results.append(json.load(f))
+
+    first = all_results[0]
+    print('%s, different log amounts' % first['language'])
+    print(size_table(first))
+    print()
+    print('100 logs, pack %d times (seconds), median of the samples' % README_TIMES)
+    print(time_table(all_results, 'pack'))
+    print()
+    print('100 logs, unpack %d times (seconds), median of the samples' % README_TIMES)
+    print(time_table(all_results, 'unpack'))
+
+    for results in all_results:
+        print()
+        print('%s, %d samples per case' % (results['language'], results['samples']))
+        print(detail_table(results))
+
+    if chart:
+        draw_chart(all_results, chart)
+        print()
+        print('chart: %s' % chart)
+
+
+if __name__ == '__main__':
+    main()
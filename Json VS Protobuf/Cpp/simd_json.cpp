@@ -0,0 +1,353 @@
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_JSON_X86 1
+#endif
+
+#include "simd_json.h"
+
+
+namespace simd_json
+{
+
+namespace
+{
+
+struct Masks
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t ws;
+};
+
+enum CharClass
+{
+    CLASS_QUOTE = 1,
+    CLASS_BACKSLASH = 2,
+    CLASS_OP = 4,
+    CLASS_WS = 8,
+};
+
+struct ClassTable
+{
+    uint8_t cls[256];
+
+    constexpr ClassTable(): cls()
+    {
+        cls[static_cast<int>('"')] = CLASS_QUOTE;
+        cls[static_cast<int>('\\')] = CLASS_BACKSLASH;
+        cls[static_cast<int>('{')] = CLASS_OP;
+        cls[static_cast<int>('}')] = CLASS_OP;
+        cls[static_cast<int>('[')] = CLASS_OP;
+        cls[static_cast<int>(']')] = CLASS_OP;
+        cls[static_cast<int>(':')] = CLASS_OP;
+        cls[static_cast<int>(',')] = CLASS_OP;
+        cls[static_cast<int>(' ')] = CLASS_WS;
+        cls[static_cast<int>('\t')] = CLASS_WS;
+        cls[static_cast<int>('\n')] = CLASS_WS;
+        cls[static_cast<int>('\r')] = CLASS_WS;
+    }
+};
+
+constexpr ClassTable class_table{};
+
+CODEC_INLINE Masks classify_scalar(const char* block)
+{
+    Masks m = {0, 0, 0, 0};
+    for(int i=0; i<64; i++)
+    {
+        uint64_t cls = class_table.cls[static_cast<uint8_t>(block[i])];
+        m.quote |= (cls & 1) << i;
+        m.backslash |= ((cls >> 1) & 1) << i;
+        m.op |= ((cls >> 2) & 1) << i;
+        m.ws |= ((cls >> 3) & 1) << i;
+    }
+    return m;
+}
+
+#ifdef SIMD_JSON_X86
+
+__attribute__((target("sse2"), always_inline))
+inline Masks classify_sse2(const char* block)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i brace_open = _mm_set1_epi8('{');
+    const __m128i brace_close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    Masks m = {0, 0, 0, 0};
+    for(int k=0; k<4; k++)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * k));
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        __m128i folded = _mm_or_si128(v, lower);
+        __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(folded, brace_open), _mm_cmpeq_epi8(folded, brace_close)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+
+        int shift = 16 * k;
+        m.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        m.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        m.op |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(op))) << shift;
+        m.ws |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ws))) << shift;
+    }
+    return m;
+}
+
+__attribute__((target("avx2"), always_inline))
+inline Masks classify_avx2(const char* block)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i brace_open = _mm256_set1_epi8('{');
+    const __m256i brace_close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+
+    Masks m = {0, 0, 0, 0};
+    for(int k=0; k<2; k++)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * k));
+        __m256i folded = _mm256_or_si256(v, lower);
+        __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(folded, brace_open), _mm256_cmpeq_epi8(folded, brace_close)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+
+        int shift = 32 * k;
+        m.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+        m.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+        m.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << shift;
+        m.ws |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << shift;
+    }
+    return m;
+}
+
+#endif // SIMD_JSON_X86
+
+CODEC_INLINE uint64_t prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// turns the masks of consecutive blocks into index entries
+class BlockState
+{
+public:
+    BlockState():
+        escaped_(0), in_string_(0), scalar_(0), backslashes_(0)
+    {}
+
+    CODEC_INLINE uint32_t* consume(const Masks& m, uint32_t base, uint32_t* out)
+    {
+        backslashes_ |= m.backslash;
+        uint64_t quote = m.quote & ~escaped_chars(m.backslash);
+
+        // set from an opening quote up to (not including) its closing quote
+        uint64_t in_string = prefix_xor(quote) ^ in_string_;
+        in_string_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        uint64_t scalar = ~(m.op | m.ws | quote | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | scalar_);
+        scalar_ = scalar >> 63;
+
+        uint64_t bits = (m.op & ~in_string) | quote | scalar_start;
+        while(bits)
+        {
+            *out++ = base + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+        return out;
+    }
+
+    bool in_string() const
+    {
+        return in_string_ != 0;
+    }
+
+    bool escapes() const
+    {
+        return backslashes_ != 0;
+    }
+
+private:
+    // characters preceded by an odd run of backslashes.
+    // backslashes are rare, so walking them one by one is cheap.
+    CODEC_INLINE uint64_t escaped_chars(uint64_t backslash)
+    {
+        uint64_t escaped = escaped_;
+        uint64_t b = backslash & ~escaped_;
+        escaped_ = 0;
+        while(b)
+        {
+            int i = __builtin_ctzll(b);
+            if(i == 63)
+            {
+                escaped_ = 1;
+                break;
+            }
+
+            uint64_t next = 1ull << (i + 1);
+            escaped |= next;
+            b &= ~next;
+            b &= b - 1;
+        }
+        return escaped;
+    }
+
+    uint64_t escaped_;
+    uint64_t in_string_;
+    uint64_t scalar_;
+    uint64_t backslashes_;
+};
+
+uint32_t* index_scalar(const char* data, std::size_t size, BlockState& state, uint32_t* out)
+{
+    for(std::size_t i=0; i<size; i+=64)
+    {
+        out = state.consume(classify_scalar(data + i), i, out);
+    }
+    return out;
+}
+
+#ifdef SIMD_JSON_X86
+
+__attribute__((target("sse2")))
+uint32_t* index_sse2(const char* data, std::size_t size, BlockState& state, uint32_t* out)
+{
+    for(std::size_t i=0; i<size; i+=64)
+    {
+        out = state.consume(classify_sse2(data + i), i, out);
+    }
+    return out;
+}
+
+__attribute__((target("avx2")))
+uint32_t* index_avx2(const char* data, std::size_t size, BlockState& state, uint32_t* out)
+{
+    for(std::size_t i=0; i<size; i+=64)
+    {
+        out = state.consume(classify_avx2(data + i), i, out);
+    }
+    return out;
+}
+
+#endif // SIMD_JSON_X86
+
+Kernel current_kernel = detect_kernel();
+
+}
+
+
+Kernel detect_kernel()
+{
+#ifdef SIMD_JSON_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return AVX2;
+    if(__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+    return SCALAR;
+}
+
+Kernel kernel()
+{
+    return current_kernel;
+}
+
+void set_kernel(Kernel k)
+{
+    current_kernel = k > detect_kernel() ? detect_kernel() : k;
+}
+
+const char* kernel_name(Kernel k)
+{
+    switch(k)
+    {
+    case AVX2: return "avx2";
+    case SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+bool build_index(const char* data, std::size_t size, std::vector<uint32_t>& index,
+        std::size_t& count, bool& escapes)
+{
+    if(size >= std::numeric_limits<uint32_t>::max()) return false;
+
+    // at most one entry per input byte
+    if(index.size() < size + 1)
+    {
+        index.resize(size + 1);
+    }
+
+    BlockState state;
+    uint32_t* out = index.data();
+    std::size_t full = size & ~static_cast<std::size_t>(63);
+
+    switch(current_kernel)
+    {
+#ifdef SIMD_JSON_X86
+    case AVX2:
+        out = index_avx2(data, full, state, out);
+        break;
+    case SSE2:
+        out = index_sse2(data, full, state, out);
+        break;
+#endif
+    default:
+        out = index_scalar(data, full, state, out);
+    }
+
+    if(full < size)
+    {
+        // pad the last block with whitespace, which produces no entries
+        char block[64];
+        std::memset(block, ' ', sizeof(block));
+        std::memcpy(block, data + full, size - full);
+        out = state.consume(classify_scalar(block), full, out);
+    }
+
+    count = out - index.data();
+    escapes = state.escapes();
+    return !state.in_string();
+}
+
+
+bool Parser::parse(const char* data, std::size_t size, codec::Person& out)
+{
+    std::size_t count;
+    bool escapes;
+    if(!build_index(data, size, index_, count, escapes)) return false;
+
+    IndexReader r(data, size, index_, count, escapes);
+    codec::clear(out);
+    return codec::json_merge(r, out) && r.at_end();
+}
+
+}
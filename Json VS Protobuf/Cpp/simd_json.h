@@ -0,0 +1,261 @@
+#ifndef __SIMD_JSON_H__
+#define __SIMD_JSON_H__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "protocol_codec.h"
+
+// two pass json decoding.
+//
+// stage 1 classifies the input 64 bytes at a time with SIMD compares
+// and records the offset of every structural character ({}[]:,),
+// every unescaped quote and the first byte of every number/literal.
+// stage 2 walks that index with IndexReader, which drives the
+// generated codec::json_merge, so Person/Log are filled directly.
+namespace simd_json
+{
+
+enum Kernel
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// best kernel this cpu supports
+Kernel detect_kernel();
+
+// kernel used by build_index, detect_kernel() unless overridden
+Kernel kernel();
+void set_kernel(Kernel k);
+
+const char* kernel_name(Kernel k);
+
+// stage 1, writes `count` offsets to the front of `index`
+// (which is only ever grown). `escapes` is set if there is a backslash
+// anywhere in the input. false if a string is not terminated.
+bool build_index(const char* data, std::size_t size, std::vector<uint32_t>& index,
+        std::size_t& count, bool& escapes);
+
+
+// stage 2, same interface as codec::JsonReader.
+// every method is inline: it runs once per token, and a call per
+// token cost more than the work. a string's body is the span between
+// its two quotes in the index, only looked at again for escapes when
+// stage 1 saw a backslash somewhere.
+class IndexReader
+{
+public:
+    IndexReader(const char* data, std::size_t size, const std::vector<uint32_t>& index,
+            std::size_t count, bool escapes):
+        data_(data), size_(size), index_(index.data()), count_(count), i_(0), error_(false),
+        escapes_(escapes)
+    {}
+
+    bool ok() const
+    {
+        return !error_;
+    }
+
+    bool at_end() const
+    {
+        return !error_ && i_ == count_;
+    }
+
+    bool begin_object() { return expect('{'); }
+    bool end_object() { return accept('}'); }
+    bool next_member() { return next(',', '}'); }
+    bool begin_array() { return expect('['); }
+    bool end_array() { return accept(']'); }
+    bool next_element() { return next(',', ']'); }
+
+    bool read_key(std::string_view& key)
+    {
+        if(!raw_string(key)) return false;
+
+        if(escapes_ && std::memchr(key.data(), '\\', key.size()))
+        {
+            codec::JsonReader r(key.data() - 1, key.data() + key.size() + 1);
+            if(!r.read_string(scratch_)) return fail();
+            key = scratch_;
+        }
+        return expect(':');
+    }
+
+    bool read_null()
+    {
+        if(peek() != 'n') return false;
+
+        const char* p = data_ + index_[i_];
+        if(data_ + size_ - p < 4 || std::memcmp(p, "null", 4) != 0 || !at_scalar_end(p + 4)) return fail();
+        i_++;
+        return true;
+    }
+
+    bool read_bool(bool& v)
+    {
+        const char* p = data_ + index_[i_ < count_ ? i_ : 0];
+        std::size_t left = data_ + size_ - p;
+
+        if(peek() == 't' && left >= 4 && std::memcmp(p, "true", 4) == 0 && at_scalar_end(p + 4))
+        {
+            v = true;
+        }
+        else if(peek() == 'f' && left >= 5 && std::memcmp(p, "false", 5) == 0 && at_scalar_end(p + 5))
+        {
+            v = false;
+        }
+        else
+        {
+            return fail();
+        }
+
+        i_++;
+        return true;
+    }
+
+    bool read_string(std::string& out)
+    {
+        std::string_view raw;
+        if(!raw_string(raw)) return false;
+
+        if(escapes_ && std::memchr(raw.data(), '\\', raw.size()))
+        {
+            codec::JsonReader r(raw.data() - 1, raw.data() + raw.size() + 1);
+            return r.read_string(out) || fail();
+        }
+
+        out.assign(raw.data(), raw.size());
+        return true;
+    }
+
+    bool skip_value()
+    {
+        std::string_view raw;
+        switch(peek())
+        {
+        case '{':
+        case '[':
+            {
+                // only the nesting of skipped values is checked
+                int depth = 0;
+                do
+                {
+                    char t = peek();
+                    if(t == '{' || t == '[') depth++;
+                    else if(t == '}' || t == ']') depth--;
+                    else if(t == '\0') return fail();
+                    i_++;
+                } while(depth > 0);
+                return true;
+            }
+        case '"':
+            return raw_string(raw);
+        case '\0':
+        case ',':
+        case ':':
+        case '}':
+        case ']':
+            return fail();
+        default:
+            i_++;
+            return true;
+        }
+    }
+
+    template<class T>
+    bool read_integer(T& v)
+    {
+        if(i_ >= count_) return fail();
+
+        const char* p = data_ + index_[i_];
+        const char* end = data_ + size_;
+        if(!codec::parse_integer(p, end, v) || !at_scalar_end(p)) return fail();
+        i_++;
+        return true;
+    }
+
+private:
+    char peek() const
+    {
+        return i_ < count_ ? data_[index_[i_]] : '\0';
+    }
+
+    bool fail()
+    {
+        error_ = true;
+        return false;
+    }
+
+    bool expect(char c)
+    {
+        if(peek() != c) return fail();
+        i_++;
+        return true;
+    }
+
+    bool accept(char c)
+    {
+        if(peek() != c) return false;
+        i_++;
+        return true;
+    }
+
+    bool next(char more, char close)
+    {
+        char c = peek();
+        i_++;
+        if(c == more) return true;
+        if(c == close) return false;
+        return fail();
+    }
+
+    bool at_scalar_end(const char* p) const
+    {
+        if(p == data_ + size_) return true;
+        char c = *p;
+        return c == ',' || c == '}' || c == ']' || c == ':'
+                || c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    // body of the string at the current quote, escapes untouched.
+    // the closing quote is the next index entry
+    bool raw_string(std::string_view& raw)
+    {
+        if(peek() != '"' || i_ + 1 >= count_) return fail();
+
+        uint32_t open = index_[i_];
+        uint32_t close = index_[i_ + 1];
+        raw = std::string_view(data_ + open + 1, close - open - 1);
+        i_ += 2;
+        return true;
+    }
+
+    const char* data_;
+    std::size_t size_;
+    const uint32_t* index_;
+    std::size_t count_;
+    std::size_t i_;
+    bool error_;
+    bool escapes_;
+    std::string scratch_;
+};
+
+
+// keeps the index buffer between calls
+class Parser
+{
+public:
+    bool parse(const char* data, std::size_t size, codec::Person& out);
+
+private:
+    std::vector<uint32_t> index_;
+};
+
+}
+
+#endif // __SIMD_JSON_H__
@@ -0,0 +1,590 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VARINT_X86 1
+#endif
+
+#include "codec_runtime.h"
+#include "varint_batch.h"
+
+
+namespace varint
+{
+
+namespace
+{
+
+CODEC_INLINE bool read_int32(const char*& p, const char* end, int32_t& out)
+{
+    uint64_t v;
+    if(!codec::read_varint(p, end, v)) return false;
+    out = static_cast<int32_t>(v);
+    return true;
+}
+
+CODEC_INLINE char* write_int32(char* p, int32_t v)
+{
+    return codec::write_varint(p, static_cast<uint64_t>(static_cast<int64_t>(v)));
+}
+
+
+// ---- scalar ----
+
+std::size_t count_scalar(const char* p, const char* end)
+{
+    std::size_t n = 0;
+    for(; p < end; p++)
+    {
+        n += static_cast<uint8_t>(*p) < 0x80;
+    }
+    return n;
+}
+
+bool decode_scalar(const char* p, const char* end, int32_t* out)
+{
+    while(p < end)
+    {
+        if(!read_int32(p, end, *out++)) return false;
+    }
+    return true;
+}
+
+const char* tagged_scalar(const char* p, const char* end, uint8_t key, std::vector<int32_t>& out)
+{
+    while(p < end && static_cast<uint8_t>(*p) == key)
+    {
+        p++;
+        int32_t v;
+        if(!read_int32(p, end, v)) return NULL;
+        out.push_back(v);
+    }
+    return p;
+}
+
+char* encode_scalar(const int32_t* v, std::size_t n, char* p)
+{
+    for(std::size_t i=0; i<n; i++)
+    {
+        p = write_int32(p, v[i]);
+    }
+    return p;
+}
+
+
+#ifdef VARINT_X86
+
+// how the 12 bytes behind one continuation mask are decoded
+enum Shape : uint8_t
+{
+    // the first varint is longer than 3 bytes or not complete in 12
+    SHAPE_SCALAR,
+    // `count` (up to 8) varints of 1-2 bytes, one per 16 bit lane
+    SHAPE_16,
+    // `count` (up to 4) varints of 1-3 bytes, one per 32 bit lane
+    SHAPE_32,
+};
+
+struct Pattern
+{
+    uint8_t shape;
+    uint8_t count;
+    uint8_t consumed;
+    // pshufb control, 0x80 zeroes the lane byte
+    uint8_t shuffle[16];
+};
+
+struct PatternTable
+{
+    Pattern entry[4096];
+
+    PatternTable()
+    {
+        for(int mask=0; mask<4096; mask++)
+        {
+            build(mask, entry[mask]);
+        }
+    }
+
+    static void build(int mask, Pattern& e)
+    {
+        // lengths of the varints that end inside the 12 bytes
+        int lengths[12];
+        int n = 0;
+        int len = 0;
+        for(int i=0; i<12; i++)
+        {
+            len++;
+            if(!(mask & (1 << i)))
+            {
+                lengths[n++] = len;
+                len = 0;
+            }
+        }
+
+        e = Pattern();
+        for(auto& s: e.shuffle) s = 0x80;
+
+        if(n == 0 || lengths[0] > 3)
+        {
+            e.shape = SHAPE_SCALAR;
+            return;
+        }
+
+        int lane_bytes = lengths[0] <= 2 ? 2 : 4;
+        int max_len = lengths[0] <= 2 ? 2 : 3;
+        int lanes = 16 / lane_bytes;
+        e.shape = lane_bytes == 2 ? SHAPE_16 : SHAPE_32;
+
+        int at = 0;
+        for(int i=0; i<n && i<lanes && lengths[i] <= max_len; i++)
+        {
+            for(int b=0; b<lengths[i]; b++)
+            {
+                e.shuffle[i * lane_bytes + b] = static_cast<uint8_t>(at + b);
+            }
+            at += lengths[i];
+            e.count++;
+        }
+        e.consumed = static_cast<uint8_t>(at);
+    }
+};
+
+const PatternTable& patterns()
+{
+    static const PatternTable table;
+    return table;
+}
+
+// 8 varints of 1-2 bytes at most, all lanes written, `e.count` valid
+__attribute__((target("sse4.1,ssse3"), always_inline))
+inline void decode_16(__m128i in, const Pattern& e, int32_t* out)
+{
+    __m128i v = _mm_shuffle_epi8(in, _mm_loadu_si128(reinterpret_cast<const __m128i*>(e.shuffle)));
+    __m128i low = _mm_and_si128(v, _mm_set1_epi16(0x007f));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi16(0x3f80));
+    v = _mm_or_si128(low, high);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvtepu16_epi32(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+}
+
+// 4 varints of 1-3 bytes at most
+__attribute__((target("sse4.1,ssse3"), always_inline))
+inline void decode_32(__m128i in, const Pattern& e, int32_t* out)
+{
+    __m128i v = _mm_shuffle_epi8(in, _mm_loadu_si128(reinterpret_cast<const __m128i*>(e.shuffle)));
+    __m128i b0 = _mm_and_si128(v, _mm_set1_epi32(0x7f));
+    __m128i b1 = _mm_and_si128(_mm_srli_epi32(v, 1), _mm_set1_epi32(0x3f80));
+    __m128i b2 = _mm_and_si128(_mm_srli_epi32(v, 2), _mm_set1_epi32(0x1fc000));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(b0, _mm_or_si128(b1, b2)));
+}
+
+// one step of the masked-VByte loop, needs 16 readable bytes and
+// 16 writable values. false on a malformed varint.
+__attribute__((target("sse4.1,ssse3"), always_inline))
+inline bool decode_step(const char*& p, const char* end, int32_t*& out, const PatternTable& table)
+{
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(in));
+
+    if(mask == 0)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvtepu8_epi32(in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_cvtepu8_epi32(_mm_srli_si128(in, 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_cvtepu8_epi32(_mm_srli_si128(in, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_cvtepu8_epi32(_mm_srli_si128(in, 12)));
+        p += 16;
+        out += 16;
+        return true;
+    }
+
+    const Pattern& e = table.entry[mask & 0xfff];
+    switch(e.shape)
+    {
+    case SHAPE_16:
+        decode_16(in, e, out);
+        break;
+    case SHAPE_32:
+        decode_32(in, e, out);
+        break;
+    default:
+        return read_int32(p, end, *out++);
+    }
+
+    p += e.consumed;
+    out += e.count;
+    return true;
+}
+
+__attribute__((target("sse4.1,ssse3")))
+bool decode_sse4(const char* p, const char* end, int32_t* out, int32_t* out_end)
+{
+    const PatternTable& table = patterns();
+    while(end - p >= 16 && out_end - out >= 16)
+    {
+        if(!decode_step(p, end, out, table)) return false;
+    }
+    return decode_scalar(p, end, out);
+}
+
+__attribute__((target("avx2")))
+bool decode_avx2(const char* p, const char* end, int32_t* out, int32_t* out_end)
+{
+    const PatternTable& table = patterns();
+    while(end - p >= 32 && out_end - out >= 32)
+    {
+        // 32 one byte values
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if(_mm256_movemask_epi8(in) == 0)
+        {
+            __m128i lo = _mm256_castsi256_si128(in);
+            __m128i hi = _mm256_extracti128_si256(in, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_cvtepu8_epi32(lo));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), _mm256_cvtepu8_epi32(hi));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+            p += 32;
+            out += 32;
+            continue;
+        }
+        if(!decode_step(p, end, out, table)) return false;
+    }
+    while(end - p >= 16 && out_end - out >= 16)
+    {
+        if(!decode_step(p, end, out, table)) return false;
+    }
+    return decode_scalar(p, end, out);
+}
+
+__attribute__((target("sse2")))
+std::size_t count_sse2(const char* p, const char* end)
+{
+    std::size_t n = 0;
+    for(; end - p >= 16; p += 16)
+    {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        n += 16 - __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(in)));
+    }
+    return n + count_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+std::size_t count_avx2(const char* p, const char* end)
+{
+    std::size_t n = 0;
+    for(; end - p >= 32; p += 32)
+    {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        n += 32 - __builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(in)));
+    }
+    return n + count_scalar(p, end);
+}
+
+// 8 pairs of `key` + one byte value
+__attribute__((target("sse4.1,ssse3")))
+const char* tagged_sse4(const char* p, const char* end, uint8_t key, std::vector<int32_t>& out)
+{
+    const __m128i keys = _mm_set1_epi8(static_cast<char>(key));
+    const __m128i odd = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    while(end - p >= 16)
+    {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned is_key = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(in, keys)));
+        unsigned high = static_cast<unsigned>(_mm_movemask_epi8(in));
+        if((is_key & 0x5555) != 0x5555 || (high & 0xaaaa) != 0)
+        {
+            // the run ends or a value is longer than a byte, one pair the slow way
+            if(static_cast<uint8_t>(*p) != key) return p;
+            p++;
+            int32_t v;
+            if(!read_int32(p, end, v)) return NULL;
+            out.push_back(v);
+            continue;
+        }
+
+        __m128i values = _mm_shuffle_epi8(in, odd);
+        std::size_t n = out.size();
+        out.resize(n + 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[n]), _mm_cvtepu8_epi32(values));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[n + 4]), _mm_cvtepu8_epi32(_mm_srli_si128(values, 4)));
+        p += 16;
+    }
+    return tagged_scalar(p, end, key, out);
+}
+
+// how 4 values of 1-3 bytes are packed, indexed by the masks of the
+// lanes >= 1 << 7 (low 4 bits) and >= 1 << 14 (high 4 bits)
+struct PackPattern
+{
+    uint8_t size;
+    uint8_t shuffle[16];
+};
+
+struct PackTable
+{
+    PackPattern entry[256];
+
+    PackTable()
+    {
+        for(int mask=0; mask<256; mask++)
+        {
+            PackPattern& e = entry[mask];
+            e = PackPattern();
+            for(auto& s: e.shuffle) s = 0x80;
+
+            int at = 0;
+            for(int i=0; i<4; i++)
+            {
+                int len = 1 + ((mask >> i) & 1) + ((mask >> (4 + i)) & 1);
+                for(int b=0; b<len; b++)
+                {
+                    e.shuffle[at++] = static_cast<uint8_t>(i * 4 + b);
+                }
+            }
+            e.size = static_cast<uint8_t>(at);
+        }
+    }
+};
+
+const PackTable& pack_patterns()
+{
+    static const PackTable table;
+    return table;
+}
+
+// 4 values below 1 << 21, written as 1-3 byte varints.
+// stores 16 bytes, at most 12 of them used.
+__attribute__((target("sse4.1,ssse3"), always_inline))
+inline char* encode_4(__m128i v, char* p, const PackTable& table)
+{
+    __m128i two = _mm_cmpgt_epi32(v, _mm_set1_epi32(0x7f));
+    __m128i three = _mm_cmpgt_epi32(v, _mm_set1_epi32(0x3fff));
+
+    // 7 bit groups in bytes 0-2 of each lane, with their continuation bits
+    __m128i b0 = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x7f)), _mm_and_si128(two, _mm_set1_epi32(0x80)));
+    __m128i b1 = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 1), _mm_set1_epi32(0x7f00)), _mm_and_si128(three, _mm_set1_epi32(0x8000)));
+    __m128i b2 = _mm_and_si128(_mm_slli_epi32(v, 2), _mm_set1_epi32(0x7f0000));
+    __m128i lanes = _mm_or_si128(b0, _mm_or_si128(b1, b2));
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(two)))
+        | static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(three))) << 4;
+    const PackPattern& e = table.entry[mask];
+    __m128i packed = _mm_shuffle_epi8(lanes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(e.shuffle)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+    return p + e.size;
+}
+
+// 16 values from `v + i`. the stores may run up to 15 bytes past the
+// block, so at least 16 more values (each at least a byte) must follow.
+__attribute__((target("sse4.1,ssse3"), always_inline))
+inline char* encode_16(const int32_t* v, char* p, const PackTable& table)
+{
+    auto in = reinterpret_cast<const __m128i*>(v);
+    __m128i a = _mm_loadu_si128(in);
+    __m128i b = _mm_loadu_si128(in + 1);
+    __m128i c = _mm_loadu_si128(in + 2);
+    __m128i d = _mm_loadu_si128(in + 3);
+
+    __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+    if(_mm_testz_si128(any, _mm_set1_epi32(~0x7f)))
+    {
+        __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), bytes);
+        return p + 16;
+    }
+    if(_mm_testz_si128(any, _mm_set1_epi32(~0x1fffff)))
+    {
+        p = encode_4(a, p, table);
+        p = encode_4(b, p, table);
+        p = encode_4(c, p, table);
+        return encode_4(d, p, table);
+    }
+    // negative or large values
+    return encode_scalar(v, 16, p);
+}
+
+__attribute__((target("sse4.1,ssse3")))
+char* encode_sse4(const int32_t* v, std::size_t n, char* p)
+{
+    const PackTable& table = pack_patterns();
+    std::size_t i = 0;
+    for(; i + 32 <= n; i += 16)
+    {
+        p = encode_16(v + i, p, table);
+    }
+    return encode_scalar(v + i, n - i, p);
+}
+
+__attribute__((target("avx2")))
+char* encode_avx2(const int32_t* v, std::size_t n, char* p)
+{
+    const PackTable& table = pack_patterns();
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    std::size_t i = 0;
+    for(; i + 48 <= n; i += 32)
+    {
+        auto in = reinterpret_cast<const __m256i*>(v + i);
+        __m256i a = _mm256_loadu_si256(in);
+        __m256i b = _mm256_loadu_si256(in + 1);
+        __m256i c = _mm256_loadu_si256(in + 2);
+        __m256i d = _mm256_loadu_si256(in + 3);
+
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if(!_mm256_testz_si256(any, _mm256_set1_epi32(~0x7f)))
+        {
+            p = encode_16(v + i, p, table);
+            p = encode_16(v + i + 16, p, table);
+            continue;
+        }
+
+        // packs work per 128 bit lane, the permute puts the 4 byte groups back in order
+        __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+        bytes = _mm256_permutevar8x32_epi32(bytes, order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), bytes);
+        p += 32;
+    }
+    for(; i + 32 <= n; i += 16)
+    {
+        p = encode_16(v + i, p, table);
+    }
+    return encode_scalar(v + i, n - i, p);
+}
+
+#endif // VARINT_X86
+
+Kernel current_kernel = detect_kernel();
+
+}
+
+
+Kernel detect_kernel()
+{
+#ifdef VARINT_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return AVX2;
+    if(__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) return SSE4;
+#endif
+    return SCALAR;
+}
+
+Kernel kernel()
+{
+    return current_kernel;
+}
+
+void set_kernel(Kernel k)
+{
+    current_kernel = k > detect_kernel() ? detect_kernel() : k;
+}
+
+const char* kernel_name(Kernel k)
+{
+    switch(k)
+    {
+    case AVX2: return "avx2";
+    case SSE4: return "sse4";
+    default: return "scalar";
+    }
+}
+
+std::size_t count(const char* p, const char* end)
+{
+#ifdef VARINT_X86
+    switch(current_kernel)
+    {
+    case AVX2: return count_avx2(p, end);
+    case SSE4: return count_sse2(p, end);
+    default: break;
+    }
+#endif
+    return count_scalar(p, end);
+}
+
+bool append_int32(const char* p, const char* end, std::vector<int32_t>& out)
+{
+    if(p == end) return true;
+    // the last byte must end a varint
+    if(static_cast<uint8_t>(end[-1]) >= 0x80) return false;
+
+    std::size_t n = out.size();
+    if(current_kernel == SCALAR)
+    {
+        // without SIMD counting first does not pay off
+        while(p < end)
+        {
+            int32_t v;
+            if(!read_int32(p, end, v))
+            {
+                out.resize(n);
+                return false;
+            }
+            out.push_back(v);
+        }
+        return true;
+    }
+
+    std::size_t added = count(p, end);
+    out.resize(n + added);
+
+    int32_t* first = out.data() + n;
+    int32_t* last = first + added;
+    bool ok;
+    switch(current_kernel)
+    {
+#ifdef VARINT_X86
+    case AVX2:
+        ok = decode_avx2(p, end, first, last);
+        break;
+    case SSE4:
+        ok = decode_sse4(p, end, first, last);
+        break;
+#endif
+    default:
+        ok = decode_scalar(p, end, first);
+    }
+
+    if(!ok)
+    {
+        out.resize(n);
+    }
+    return ok;
+}
+
+const char* append_tagged_int32(const char* p, const char* end, uint8_t key, std::vector<int32_t>& out)
+{
+#ifdef VARINT_X86
+    if(current_kernel != SCALAR)
+    {
+        return tagged_sse4(p, end, key, out);
+    }
+#endif
+    return tagged_scalar(p, end, key, out);
+}
+
+std::size_t encoded_size_int32(const int32_t* v, std::size_t n)
+{
+    std::size_t size = 0;
+    for(std::size_t i=0; i<n; i++)
+    {
+        size += codec::varint_size(static_cast<uint64_t>(static_cast<int64_t>(v[i])));
+    }
+    return size;
+}
+
+char* encode_int32(const int32_t* v, std::size_t n, char* p)
+{
+    switch(current_kernel)
+    {
+#ifdef VARINT_X86
+    case AVX2:
+        return encode_avx2(v, n, p);
+    case SSE4:
+        return encode_sse4(v, n, p);
+#endif
+    default:
+        return encode_scalar(v, n, p);
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef __VARINT_BATCH_H__
+#define __VARINT_BATCH_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// many int32 varints at once.
+//
+// decode is masked-VByte style: the continuation bits of the next 16
+// bytes are gathered into a mask, and the low 12 bits of it pick a
+// precomputed shuffle that moves up to 8 varints of 1-2 bytes (or 4 of
+// 1-3 bytes) into their own lanes, where the 7 bit groups are joined
+// with shifts. longer varints (negative int32 take 10 bytes) go through
+// the scalar decoder one at a time.
+// encode packs 4 values of 1-3 bytes with one shuffle, or 16 at once
+// when they all fit in one byte.
+//
+// kernels are picked at runtime like in simd_json.h.
+namespace varint
+{
+
+enum Kernel
+{
+    SCALAR,
+    SSE4,
+    AVX2,
+};
+
+// best kernel this cpu supports
+Kernel detect_kernel();
+
+// kernel used by everything below, detect_kernel() unless overridden
+Kernel kernel();
+void set_kernel(Kernel k);
+
+const char* kernel_name(Kernel k);
+
+// number of varints in [p, end), that is bytes without the continuation bit
+std::size_t count(const char* p, const char* end);
+
+// decodes every varint in [p, end) as int32 (the low 32 bits, like
+// protobuf int32 fields) and appends them to `out`.
+// false if a varint is longer than 10 bytes or not terminated.
+bool append_int32(const char* p, const char* end, std::vector<int32_t>& out);
+
+// a run of unpacked entries of one field: while [p, end) starts with
+// the one byte `key`, decodes the varint after it into `out`.
+// returns where the run stops, NULL on a malformed varint.
+const char* append_tagged_int32(const char* p, const char* end, uint8_t key, std::vector<int32_t>& out);
+
+// exact size of `n` int32 values as varints
+std::size_t encoded_size_int32(const int32_t* v, std::size_t n);
+
+// writes `n` varints, returns the end
+char* encode_int32(const int32_t* v, std::size_t n, char* p);
+
+}
+
+#endif // __VARINT_BATCH_H__
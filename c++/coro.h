@@ -4,12 +4,32 @@
 #include <iostream>
 #include <string>
 #include <set>
+#include <map>
 #include <queue>
 #include <mutex>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <csignal>
+#include <execinfo.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include <utility>  // boost 1.74 asio/awaitable.hpp needs it with -std=c++20
 #include <boost/asio.hpp>
 #include <boost/coroutine/symmetric_coroutine.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "coro_slab.h"
+
+// define CORO_QUIET before including to drop the trace of every
+// context switch, e.g. when measuring a server
 namespace coro
 {
 
@@ -20,6 +40,8 @@ class Coroutine;
 class Event;
 class Scheduler;
 class Timer;
+class Profiler;
+struct ProfileStats;
 static Coroutine* spawn(std::function<void()>, std::string);
 
 namespace this_coroutine
@@ -28,6 +50,11 @@ namespace detail
 {
 Coroutine* current;
 void jump(Coroutine*);
+
+// set by Scheduler::enable_profiling, every switch then calls profile_switch
+bool profiling = false;
+void profile_switch(Coroutine* next);
+void profile_forget(Coroutine*);
 }
 
 // yield: give up the current execution
@@ -39,6 +66,48 @@ void suspend();
 std::shared_ptr<Timer> sleep_for(int);
 }
 
+// who to wake when a wait is over: a stackful Coroutine, which is
+// jumped to, or a suspended stackless task (coro_task.h), which is
+// resumed on the stack of whoever wakes it. both run until they
+// suspend again and then come back to the waker.
+struct Waiter
+{
+    Coroutine* co;
+    void (*resume)(void*);
+    void* frame;
+
+    Waiter() :
+            co(NULL), resume(NULL), frame(NULL)
+    {
+    }
+
+    Waiter(Coroutine* c) :
+            co(c), resume(NULL), frame(NULL)
+    {
+    }
+
+    // any std::coroutine_handle, kept as a template so this header
+    // still builds without C++20
+    template<class Handle>
+    static Waiter from_handle(Handle h)
+    {
+        Waiter w;
+        w.resume = [](void* frame)
+        {
+            Handle::from_address(frame).resume();
+        };
+        w.frame = h.address();
+        return w;
+    }
+
+    explicit operator bool() const
+    {
+        return co || frame;
+    }
+
+    void wake() const;
+};
+
 class Coroutine
 {
 public:
@@ -47,21 +116,38 @@ public:
     Coroutine* from;
     Coroutine* to;
     std::string name;bool active;
+    // the next function for a pooled coroutine, see Scheduler::prewarm
+    std::function<void()> func;
+    // run time while profiling, in Profiler ticks
+    uint64_t run_ticks;
+    uint64_t slices;
+    ProfileStats* profile;
+    // the outermost frame on its stack, where the profiler's frame
+    // pointer walk stops
+    void* stack_top;
 
     Coroutine(std::string n) :
-            ct(NULL), yt(NULL), from(NULL), to(NULL), name(n), active(true)
+            ct(NULL), yt(NULL), from(NULL), to(NULL), name(n), active(true),
+            func(), run_ticks(0), slices(0), profile(NULL), stack_top(NULL)
     {
     }
 
     ~Coroutine()
     {
         delete ct;
-
-        if (to)
+        // one that was never profiled is not known to the profiler,
+        // and without profiling it may not even exist
+        if (this_coroutine::detail::profiling || profile)
         {
-            to->from = NULL;
+            this_coroutine::detail::profile_forget(this);
         }
+
+        // nothing is left pointing at this one
+        unlink_to();
+        unlink_from();
+#ifndef CORO_QUIET
         std::cout << "[co] die " << name << std::endl;
+#endif
     }
 
     void add_link(Coroutine*)
@@ -79,25 +165,56 @@ public:
 
     void jump(Coroutine* target)
     {
+        target->unlink_from();
+        unlink_to();
         target->from = this;
         to = target;
         context_switch(target);
     }
 
+    // `from` and `to` come in pairs, a->to == b exactly when
+    // b->from == a, so a coroutine can be deleted without leaving a
+    // pointer to it in the other one
+    void unlink_from()
+    {
+        if (from)
+        {
+            from->to = NULL;
+            from = NULL;
+        }
+    }
+
+    void unlink_to()
+    {
+        if (to)
+        {
+            to->from = NULL;
+            to = NULL;
+        }
+    }
+
 private:
     void context_switch(Coroutine* target)
     {
+        if (this_coroutine::detail::profiling)
+        {
+            this_coroutine::detail::profile_switch(target);
+        }
         this_coroutine::detail::current = target;
         if (target)
         {
+#ifndef CORO_QUIET
             std::cout << "[co] " << name << " switch to " << target->name
                     << std::endl;
+#endif
             (*yt)(*(target->ct));
         }
         else
         {
+#ifndef CORO_QUIET
             std::cout << "[co] " << name << " return to main context"
                     << std::endl;
+#endif
             (*yt)();
         }
     }
@@ -135,12 +252,39 @@ public:
 
         if (!set_)
         {
-            wait_queue_.push(current);
+            wait_queue_.push(Waiter(current));
             current->suspend();
         }
         set_ = false;
     }
 
+    // `co_await evt.async_wait()` in a stackless task
+    struct WaitAwaiter
+    {
+        Event& evt;
+
+        bool await_ready() const
+        {
+            return evt.set_;
+        }
+
+        template<class Handle>
+        void await_suspend(Handle h)
+        {
+            evt.wait_queue_.push(Waiter::from_handle(h));
+        }
+
+        void await_resume()
+        {
+            evt.set_ = false;
+        }
+    };
+
+    WaitAwaiter async_wait()
+    {
+        return WaitAwaiter{*this};
+    }
+
     std::size_t size() const
     {
         return wait_queue_.size();
@@ -194,7 +338,7 @@ private:
             {
                 auto w = process_queue_.front();
                 process_queue_.pop();
-                this_coroutine::detail::jump(w);
+                w.wake();
             }
             process_set_ = false;
             set_ = true;
@@ -204,8 +348,8 @@ private:
     }
 
     bool set_;bool process_set_;
-    std::queue<Coroutine*> wait_queue_;
-    std::queue<Coroutine*> process_queue_;
+    std::queue<Waiter> wait_queue_;
+    std::queue<Waiter> process_queue_;
     Coroutine* co;
 };
 
@@ -213,8 +357,7 @@ template<class T>
 class Queue
 {
 public:
-    Queue() :
-            co_get_(NULL)
+    Queue()
     {
     }
 
@@ -229,11 +372,25 @@ public:
         q_.push(value);
         if (co_get_)
         {
-            this_coroutine::detail::jump(co_get_);
+            co_get_.wake();
         }
     }
 
-    T& get()
+    // put without waking the getter, notify() after the last one
+    void push(T& value)
+    {
+        q_.push(value);
+    }
+
+    void notify()
+    {
+        if (co_get_ && !q_.empty())
+        {
+            co_get_.wake();
+        }
+    }
+
+    T get()
     {
         auto current = this_coroutine::detail::current;
         if (!current)
@@ -253,7 +410,7 @@ public:
 //        std::cout << "[queue] co " << current->name << " start get" << std::endl;
         if (q_.empty())
         {
-            co_get_ = current;
+            co_get_ = Waiter(current);
             current->suspend();
         }
 
@@ -261,13 +418,405 @@ public:
 
         auto value = q_.front();
         q_.pop();
-        co_get_ = NULL;
-        return std::ref(value);
+        co_get_ = Waiter();
+        return value;
+    }
+
+    // `co_await queue.async_get()` in a stackless task
+    struct GetAwaiter
+    {
+        Queue& queue;
+
+        bool await_ready() const
+        {
+            return !queue.q_.empty();
+        }
+
+        template<class Handle>
+        void await_suspend(Handle h)
+        {
+            if (queue.co_get_)
+            {
+                std::cout << "ERROR, another coroutine is get the queue"
+                        << std::endl;
+                exit(1);
+            }
+            queue.co_get_ = Waiter::from_handle(h);
+        }
+
+        T await_resume()
+        {
+            auto value = queue.q_.front();
+            queue.q_.pop();
+            queue.co_get_ = Waiter();
+            return value;
+        }
+    };
+
+    GetAwaiter async_get()
+    {
+        return GetAwaiter{*this};
     }
 
 private:
     std::queue<T> q_;
-    Coroutine* co_get_;
+    Waiter co_get_;
+};
+
+// what Scheduler::run_busy_poll did so far
+struct PollStats
+{
+    // waits that ended while spinning, and that blocked in epoll
+    std::size_t spin_hits;
+    std::size_t blocks;
+    // time spent spinning, hits included
+    double spin_seconds;
+    // the spin budget right now
+    double budget_us;
+};
+
+// per-name totals of the Profiler
+struct ProfileStats
+{
+    std::string name;
+    uint64_t ticks;
+    uint64_t slices;
+    uint64_t max_ticks;
+    uint64_t slow;
+    std::size_t coroutines;
+};
+
+// run time of every coroutine, see Scheduler::enable_profiling.
+// a slice starts when a coroutine is switched in and ends when it
+// switches out; the time in between is read from the TSC, a few ns.
+// a stackless task counts for the coroutine that resumes it, or for
+// "[task]" when an io callback in the main context resumes it.
+//
+// with a slow threshold a watchdog thread checks the running slice
+// every threshold / 2; one that is over gets SIGURG, and the handler
+// records the stack right there, inside the code that holds the cpu.
+// the handler only copies the interrupted instruction pointer and
+// follows the frame pointers within the coroutine's stack (backtrace()
+// is not async-signal-safe); the report, symbolized with
+// backtrace_symbols, is printed when the slice ends. without
+// -fno-omit-frame-pointer the frames after the first may be missing
+// or wrong.
+class Profiler
+{
+public:
+    static Profiler* get()
+    {
+        // never destroyed, the watchdog may still look at it during exit
+        static Profiler* profiler = new Profiler();
+        return profiler;
+    }
+
+    static uint64_t ticks()
+    {
+#if defined(__x86_64__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void enable(double slow_ms)
+    {
+        if (ticks_per_us_ == 0)
+        {
+            calibrate();
+        }
+        slow_ticks_ = slow_ms > 0 ? static_cast<uint64_t>(slow_ms * 1000 * ticks_per_us_) : 0;
+        running_ = this_coroutine::detail::current;
+        start_slice(ticks());
+        this_coroutine::detail::profiling = true;
+
+        if (slow_ticks_ && !watchdog_started_)
+        {
+            start_watchdog(slow_ms);
+        }
+    }
+
+    // keeps no pointer to a coroutine but those in coroutines_, so a
+    // coroutine that was never profiled can die without telling it
+    void disable()
+    {
+        switch_to(running_);
+        running_ = NULL;
+        main_running_ = NULL;
+        this_coroutine::detail::profiling = false;
+        slow_ticks_ = 0;
+        slice_start_.store(0, std::memory_order_relaxed);
+    }
+
+    // `next` NULL: back to the main context
+    void switch_to(Coroutine* next)
+    {
+        uint64_t now = ticks();
+        if (running_)
+        {
+            account(running_, now - start_);
+        }
+
+        if (!this_coroutine::detail::current)
+        {
+            // leaving the main context, come back to what ran there
+            main_running_ = running_;
+        }
+        running_ = next ? next : main_running_;
+        start_slice(now);
+    }
+
+    // a stackless task resumed from the main context
+    void task_begin()
+    {
+        switch_to(tasks_);
+    }
+
+    void task_end()
+    {
+        uint64_t now = ticks();
+        account(tasks_, now - start_);
+        running_ = NULL;
+        start_slice(now);
+    }
+
+    void forget(Coroutine* co)
+    {
+        coroutines_.erase(co);
+        if (running_ == co)
+        {
+            running_ = NULL;
+        }
+        if (main_running_ == co)
+        {
+            main_running_ = NULL;
+        }
+    }
+
+    // the `top` names and coroutines that ran longest
+    void report(std::ostream& out, std::size_t top) const
+    {
+        std::vector<const ProfileStats*> names;
+        uint64_t total = 0;
+        for (auto& kv : by_name_)
+        {
+            names.push_back(&kv.second);
+            total += kv.second.ticks;
+        }
+        std::sort(names.begin(), names.end(),
+                [](const ProfileStats* a, const ProfileStats* b)
+                {
+                    return a->ticks > b->ticks;
+                });
+
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision(3);
+        out << std::fixed;
+
+        out << "[profile] " << to_ms(total) << " ms in coroutines, top names:" << std::endl;
+        out << std::setw(20) << "name" << std::setw(12) << "ms" << std::setw(8) << "share"
+                << std::setw(10) << "slices" << std::setw(12) << "max us"
+                << std::setw(6) << "slow" << std::setw(12) << "coroutines" << std::endl;
+        for (std::size_t i = 0; i < names.size() && i < top; i++)
+        {
+            auto s = names[i];
+            out << std::setw(20) << s->name << std::setw(12) << to_ms(s->ticks)
+                    << std::setw(7) << (total ? 100 * s->ticks / total : 0) << "%"
+                    << std::setw(10) << s->slices << std::setw(12) << to_ms(s->max_ticks) * 1000
+                    << std::setw(6) << s->slow << std::setw(12) << s->coroutines << std::endl;
+        }
+
+        std::vector<Coroutine*> cos(coroutines_.begin(), coroutines_.end());
+        std::sort(cos.begin(), cos.end(),
+                [](Coroutine* a, Coroutine* b)
+                {
+                    return a->run_ticks > b->run_ticks;
+                });
+        out << "[profile] top coroutines:" << std::endl;
+        for (std::size_t i = 0; i < cos.size() && i < top; i++)
+        {
+            out << std::setw(20) << cos[i]->name << std::setw(12) << to_ms(cos[i]->run_ticks)
+                    << std::setw(18) << cos[i]->slices << " slices" << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    Profiler() :
+            ticks_per_us_(0), slow_ticks_(0), start_(0), running_(NULL),
+            main_running_(NULL), tasks_(new Coroutine("[task]")), slice_(0),
+            slice_start_(0), sampled_slice_(0), sampled_frames_(0),
+            watchdog_started_(false)
+    {
+    }
+
+    // the main context is not timed, the watchdog skips it
+    void start_slice(uint64_t now)
+    {
+        start_ = now;
+        slice_.store(slice_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        slice_start_.store(running_ ? now : 0, std::memory_order_relaxed);
+    }
+
+    void start_watchdog(double slow_ms)
+    {
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &Profiler::on_sample;
+        sa.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGURG, &sa, NULL);
+
+        pthread_t target = pthread_self();
+        auto period = std::chrono::microseconds(std::max(static_cast<int64_t>(slow_ms * 500), static_cast<int64_t>(100)));
+        std::thread([this, target, period]()
+        {
+            uint64_t signalled = 0;
+            for (;;)
+            {
+                std::this_thread::sleep_for(period);
+                uint64_t start = slice_start_.load(std::memory_order_relaxed);
+                uint64_t slice = slice_.load(std::memory_order_relaxed);
+                uint64_t limit = slow_ticks_.load(std::memory_order_relaxed);
+                if (start && limit && slice != signalled && ticks() - start > limit)
+                {
+                    signalled = slice;
+                    pthread_kill(target, SIGURG);
+                }
+            }
+        }).detach();
+        watchdog_started_ = true;
+    }
+
+    // on the scheduler thread, in the middle of the slow slice. only
+    // reads registers and the running coroutine's stack: the frame
+    // chain is followed while it goes up and stays between the
+    // interrupted stack pointer and the top of the stack. the register
+    // names are x86_64 glibc's; elsewhere nothing is sampled and
+    // report_slow prints the stack where the slice ends
+    static void on_sample(int, siginfo_t*, void* context)
+    {
+#if defined(__x86_64__)
+        auto p = get();
+        auto co = p->running_;
+        auto regs = static_cast<ucontext_t*>(context)->uc_mcontext.gregs;
+        int n = 0;
+        p->sampled_[n++] = reinterpret_cast<void*>(regs[REG_RIP]);
+
+        auto sp = static_cast<uintptr_t>(regs[REG_RSP]);
+        auto fp = static_cast<uintptr_t>(regs[REG_RBP]);
+        auto top = co ? reinterpret_cast<uintptr_t>(co->stack_top) : 0;
+        while (n < 32 && fp >= sp && fp < top && fp % sizeof(void*) == 0)
+        {
+            auto frame = reinterpret_cast<void**>(fp);
+            p->sampled_[n++] = frame[1];
+            if (reinterpret_cast<uintptr_t>(frame[0]) <= fp)
+            {
+                break;
+            }
+            fp = reinterpret_cast<uintptr_t>(frame[0]);
+        }
+
+        p->sampled_frames_.store(n, std::memory_order_relaxed);
+        p->sampled_slice_.store(p->slice_.load(std::memory_order_relaxed), std::memory_order_release);
+#else
+        (void)context;
+#endif
+    }
+
+    void calibrate()
+    {
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t t0 = ticks();
+        while (std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(10))
+        {
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+        ticks_per_us_ = (ticks() - t0) / us;
+    }
+
+    double to_ms(uint64_t t) const
+    {
+        return t / ticks_per_us_ / 1000;
+    }
+
+    void account(Coroutine* co, uint64_t t)
+    {
+        if (!co->profile)
+        {
+            co->profile = &by_name_[co->name];
+            co->profile->name = co->name;
+            co->profile->coroutines++;
+            if (co != tasks_)
+            {
+                coroutines_.insert(co);
+            }
+        }
+        co->run_ticks += t;
+        co->slices++;
+
+        auto s = co->profile;
+        s->ticks += t;
+        s->slices++;
+        s->max_ticks = std::max(s->max_ticks, t);
+        if (slow_ticks_ && t > slow_ticks_)
+        {
+            s->slow++;
+            report_slow(co, t);
+        }
+    }
+
+    // the stack the watchdog sampled in this slice, or where the slice
+    // ends when the sample did not make it
+    void report_slow(Coroutine* co, uint64_t t)
+    {
+        std::cout << "[profile] slow: " << co->name << " ran " << to_ms(t)
+                << " ms without suspending, threshold " << to_ms(slow_ticks_) << " ms" << std::endl;
+
+        void* frames[32];
+        int n;
+        // skip the profiler and the switch when there is no sample
+        int skip;
+        if (sampled_slice_.load(std::memory_order_acquire) == slice_.load(std::memory_order_relaxed))
+        {
+            n = sampled_frames_.load(std::memory_order_relaxed);
+            std::copy(sampled_, sampled_ + n, frames);
+            skip = 0;
+        }
+        else
+        {
+            n = backtrace(frames, 32);
+            skip = 3;
+        }
+
+        char** symbols = backtrace_symbols(frames, n);
+        for (int i = skip; i < n && symbols; i++)
+        {
+            std::cout << "    " << symbols[i] << std::endl;
+        }
+        free(symbols);
+    }
+
+    double ticks_per_us_;
+    std::atomic<uint64_t> slow_ticks_;
+    uint64_t start_;
+    Coroutine* running_;
+    Coroutine* main_running_;
+    Coroutine* tasks_;
+    std::map<std::string, ProfileStats> by_name_;
+    std::set<Coroutine*> coroutines_;
+
+    // shared with the watchdog and the signal handler
+    std::atomic<uint64_t> slice_;
+    std::atomic<uint64_t> slice_start_;
+    std::atomic<uint64_t> sampled_slice_;
+    std::atomic<int> sampled_frames_;
+    void* sampled_[32];
+    bool watchdog_started_;
 };
 
 class Scheduler
@@ -307,26 +856,274 @@ public:
 
     void spawn(std::function<void()> func, std::string name)
     {
-        auto co = coro::spawn(func, name);
+        Coroutine* co;
+        if (pool_limit_)
+        {
+            if (pool_.empty())
+            {
+                // it joins the pool when it is done, if there is room
+                pool_.push_back(new_pooled());
+            }
+            co = take_pooled(func, name);
+        }
+        else
+        {
+            co = coro::spawn(func, name);
+        }
         coroutines.insert(co);
-        queue_.put(co);
+        Waiter w(co);
+        ready(w);
+    }
+
+    // a stackless task that is ready to run, see coro::spawn_task
+    void schedule(Waiter w)
+    {
+        ready(w);
+    }
+
+    // spawns between batch_begin and batch_end are only queued, the
+    // loop runs them one after another at batch_end. without it every
+    // spawn from a coroutine switches to the loop and runs the new one
+    // up to its first suspend before the spawner gets the cpu back.
+    void batch_begin()
+    {
+        batching_ = true;
+    }
+
+    void batch_end()
+    {
+        batching_ = false;
+        queue_.notify();
+    }
+
+    // parks `n` coroutines with their stacks allocated and switched
+    // into once. spawn hands them the function instead of creating a
+    // coroutine, and when it returns the coroutine parks again, up to
+    // `n` of them. call from the main context, before run()
+    void prewarm(std::size_t n)
+    {
+        pool_limit_ = n;
+        while (pool_.size() < n)
+        {
+            pool_.push_back(new_pooled());
+        }
+    }
+
+    std::size_t pooled_size() const
+    {
+        return pool_.size();
+    }
+
+    // runs the io_service like io_service().run(), for latency: when
+    // nothing is ready it spins on poll() for up to `max_spin_us`
+    // before it sleeps in epoll, so an event that comes soon is handled
+    // without a kernel wakeup. `adaptive` sizes the spin to how often
+    // it pays off, looked at every 64 waits: at least half of them
+    // ended while spinning, the budget doubles; fewer, it halves down
+    // to 0. at 0, when most sleeps were shorter than `max_spin_us` it
+    // tries a short spin again, after 1, 2, 4... up to 64 windows when
+    // the tries keep failing. a spinner that keeps the sender off its
+    // cpu never hits, so it stops. call from the main context after run()
+    void run_busy_poll(int max_spin_us, bool adaptive = true)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::duration max_spin = std::chrono::microseconds(max_spin_us);
+        const Clock::duration min_spin = max_spin / 8;
+        const std::size_t window = 64;
+        Clock::duration budget = max_spin;
+        std::size_t waits = 0;
+        std::size_t hits = 0;
+        std::size_t short_sleeps = 0;
+        // windows to wait at 0 before the next try
+        std::size_t backoff = 1;
+        std::size_t idle_windows = 0;
+
+        for (;;)
+        {
+            if (io_.poll())
+            {
+                continue;
+            }
+            if (io_.stopped())
+            {
+                break;
+            }
+
+            auto start = Clock::now();
+            auto now = start;
+            bool hit = false;
+            while (now - start < budget)
+            {
+                hit = io_.poll() > 0;
+                now = Clock::now();
+                if (hit) break;
+            }
+            poll_stats_.spin_seconds += std::chrono::duration<double>(now - start).count();
+            waits++;
+
+            if (hit)
+            {
+                poll_stats_.spin_hits++;
+                hits++;
+            }
+            else
+            {
+                io_.run_one();
+                poll_stats_.blocks++;
+                if (Clock::now() - now < max_spin)
+                {
+                    short_sleeps++;
+                }
+            }
+
+            if (adaptive && waits == window)
+            {
+                if (budget > Clock::duration(0))
+                {
+                    if (hits * 2 >= waits)
+                    {
+                        budget = std::min(max_spin, budget * 2);
+                        backoff = 1;
+                    }
+                    else if (budget / 2 < min_spin)
+                    {
+                        budget = Clock::duration(0);
+                        backoff = std::min(backoff * 2, static_cast<std::size_t>(64));
+                    }
+                    else
+                    {
+                        budget = budget / 2;
+                    }
+                }
+                else if (short_sleeps * 2 >= waits && ++idle_windows >= backoff)
+                {
+                    budget = min_spin;
+                    idle_windows = 0;
+                }
+                waits = hits = short_sleeps = 0;
+            }
+            poll_stats_.budget_us = std::chrono::duration<double, std::micro>(budget).count();
+        }
+    }
+
+    const PollStats& poll_stats() const
+    {
+        return poll_stats_;
     }
 
     void kill(Coroutine* co)
     {
         coroutines.erase(co);
-        // delete co;
+    }
+
+    // a finished coroutine hands itself over as the last thing on its
+    // stack. it may still be under the loop then (it jumped back to the
+    // loop from inside), so the loop deletes it on its next turn
+    void bury(Coroutine* co)
+    {
+        dead_.push_back(co);
+    }
+
+    // accounts the run time of every coroutine from now on. a slice
+    // longer than `slow_ms` is printed with the coroutine's name and a
+    // backtrace (0: never); build with -rdynamic for function names and
+    // -fno-omit-frame-pointer for the frames past the innermost one
+    void enable_profiling(double slow_ms = 0)
+    {
+        Profiler::get()->enable(slow_ms);
+    }
+
+    void disable_profiling()
+    {
+        Profiler::get()->disable();
+    }
+
+    // the `top` coroutine names and coroutines by run time
+    void profile_report(std::ostream& out, std::size_t top = 10) const
+    {
+        Profiler::get()->report(out, top);
+    }
+
+    // spawned tasks that have not finished yet
+    void task_started()
+    {
+        tasks_++;
+    }
+
+    void task_finished()
+    {
+        tasks_--;
     }
 
     std::size_t size() const
     {
-        return coroutines.size();
+        return coroutines.size() + tasks_;
     }
 
 private:
     Scheduler(boost::asio::io_service& io) :
-            io_(io), queue_(Queue<Coroutine*>()), co_loop_(NULL)
+            io_(io), queue_(Queue<Waiter>()), co_loop_(NULL), tasks_(0),
+            batching_(false), pool_limit_(0), poll_stats_()
+    {
+    }
+
+    void ready(Waiter& w)
+    {
+        if (batching_)
+        {
+            queue_.push(w);
+        }
+        else
+        {
+            queue_.put(w);
+        }
+    }
+
+    Coroutine* new_pooled()
     {
+        return coro::spawn(std::bind(&Scheduler::pooled, this), std::string("pooled"));
+    }
+
+    Coroutine* take_pooled(std::function<void()>& func, std::string& name)
+    {
+        auto co = pool_.back();
+        pool_.pop_back();
+        co->func = std::move(func);
+        co->name = std::move(name);
+        // profiled again under the new name
+        if (co->profile)
+        {
+            this_coroutine::detail::profile_forget(co);
+        }
+        co->profile = NULL;
+        co->run_ticks = 0;
+        co->slices = 0;
+        return co;
+    }
+
+    // the body of a pooled coroutine: the function spawn gave it, then
+    // back to the pool and wait for the next one
+    void pooled()
+    {
+        auto co = this_coroutine::detail::current;
+        for (;;)
+        {
+            {
+                // released before parking, with whatever it holds
+                auto func = std::move(co->func);
+                co->func = nullptr;
+                func();
+            }
+
+            if (pool_.size() >= pool_limit_)
+            {
+                // more at once than the pool holds, this one ends
+                return;
+            }
+            coroutines.erase(co);
+            pool_.push_back(co);
+            co->suspend();
+        }
     }
 
     void loop()
@@ -334,17 +1131,23 @@ private:
         for (;;)
         {
 //            std::cout << "[loop] start get" << std::endl;
-            auto co = queue_.get();
-//            std::cout << "[loop] got: " << co->name << std::endl;
+            auto w = queue_.get();
 
-//            std::cout << "[loop] start to run " << co->name << std::endl;
-            this_coroutine::detail::jump(co);
-//            std::cout << "[loop] back from " << co->name << std::endl;
+            // a task runs on this coroutine's stack until it suspends
+            w.wake();
 
-            if (!co->active)
-            {
-                kill(co);
-            }
+            reap();
+        }
+    }
+
+    // deletes the coroutines that have finished and switched away for
+    // good, with their stacks and whatever their functions held
+    void reap()
+    {
+        while (!dead_.empty())
+        {
+            delete dead_.back();
+            dead_.pop_back();
         }
     }
 
@@ -352,9 +1155,17 @@ private:
     static Scheduler* instance_;
 
     boost::asio::io_service& io_;
-    std::set<Coroutine*> coroutines;
-    Queue<Coroutine*> queue_;
+    // a node per spawn, recycled on the slab
+    std::set<Coroutine*, std::less<Coroutine*>, SlabAllocator<Coroutine*>> coroutines;
+    Queue<Waiter> queue_;
     Coroutine* co_loop_;
+    std::size_t tasks_;
+    bool batching_;
+    std::vector<Coroutine*> pool_;
+    std::size_t pool_limit_;
+    // finished, deleted by the loop
+    std::vector<Coroutine*> dead_;
+    PollStats poll_stats_;
 };
 
 class Timer
@@ -391,6 +1202,53 @@ private:
     Coroutine* co;
 };
 
+// `co_await coro::async_sleep_for(seconds)` in a stackless task,
+// the timer lives in the task's frame
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(int seconds) :
+            t_(Scheduler::get()->io_service()), seconds_(seconds)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    template<class Handle>
+    void await_suspend(Handle h)
+    {
+        Waiter w = Waiter::from_handle(h);
+        t_.expires_from_now(boost::posix_time::seconds(seconds_));
+        t_.async_wait([w](const boost::system::error_code& error)
+        {
+            if (error)
+            {
+                std::cout << "Timer error: " << error << std::endl;
+            }
+            else
+            {
+                w.wake();
+            }
+        });
+    }
+
+    void await_resume()
+    {
+    }
+
+private:
+    boost::asio::deadline_timer t_;
+    int seconds_;
+};
+
+inline SleepAwaiter async_sleep_for(int seconds)
+{
+    return SleepAwaiter(seconds);
+}
+
 static Coroutine* spawn(std::function<void()> func, std::string name)
 {
     Coroutine* co = new Coroutine(name);
@@ -398,6 +1256,7 @@ static Coroutine* spawn(std::function<void()> func, std::string name)
     auto func_wrapper = [co](yield_type& yield, std::function<void()> co_func)
     {
         co->yt = &yield;
+        co->stack_top = __builtin_frame_address(0);
         co->suspend();
 
         // enter func
@@ -407,11 +1266,16 @@ static Coroutine* spawn(std::function<void()> func, std::string name)
             auto from = co->from;
 
             Scheduler::get()->kill(co);
+            if (this_coroutine::detail::profiling)
+            {
+                this_coroutine::detail::profile_switch(NULL);
+            }
             this_coroutine::detail::current = NULL;
             if(from)
             {
                 this_coroutine::detail::jump(from);
             }
+            Scheduler::get()->bury(co);
         };
 
     call_type* ct = new call_type(
@@ -433,12 +1297,44 @@ void this_coroutine::detail::jump(Coroutine* other)
     {
         // call in main context
 //        std::cout << "[main] jump from main context to " << other->name << std::endl;
-        other->from = NULL;
+        if (this_coroutine::detail::profiling)
+        {
+            this_coroutine::detail::profile_switch(other);
+        }
+        other->unlink_from();
         this_coroutine::detail::current = other;
         (*(other->ct))();
     }
 }
 
+void this_coroutine::detail::profile_switch(Coroutine* next)
+{
+    Profiler::get()->switch_to(next);
+}
+
+void this_coroutine::detail::profile_forget(Coroutine* co)
+{
+    Profiler::get()->forget(co);
+}
+
+void Waiter::wake() const
+{
+    if (resume && this_coroutine::detail::profiling && !this_coroutine::detail::current)
+    {
+        Profiler::get()->task_begin();
+        resume(frame);
+        Profiler::get()->task_end();
+    }
+    else if (resume)
+    {
+        resume(frame);
+    }
+    else
+    {
+        this_coroutine::detail::jump(co);
+    }
+}
+
 void this_coroutine::yield()
 {
     if (!this_coroutine::detail::current)
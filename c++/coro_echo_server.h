@@ -4,22 +4,43 @@
 #include <iostream>
 #include <string>
 #include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <utility>
 #include <boost/asio.hpp>
+#include <boost/version.hpp>
+#include <sys/socket.h>
 
 #include "coro.h"
+#include "coro_slab.h"
+#ifdef __cpp_impl_coroutine
+#include "coro_task.h"
+#endif
 
 using boost::asio::ip::tcp;
 
+// connections are allocated on the per-thread slab (coro_slab.h), with
+// their read buffers and the memory of every pending asio operation, so
+// requests on an open connection do not allocate
 class Connection: public std::enable_shared_from_this<Connection>
 {
 public:
     Connection(tcp::socket&& socket):
-        socket_(std::move(socket))
+        socket_(std::move(socket)),
+        rbuf_(16 * 1024),
+        rbegin_(0),
+        rend_(0)
     {}
 
     boost::asio::io_service& io_service()
     {
+#if BOOST_VERSION >= 107000
+        return static_cast<boost::asio::io_service&>(socket_.get_executor().context());
+#else
         return socket_.get_io_service();
+#endif
     }
 
     std::string recv(const std::size_t& size)
@@ -31,7 +52,7 @@ public:
 
         socket_.async_read_some(
                 boost::asio::buffer(buf),
-                [current, &has_error](const boost::system::error_code& error, std::size_t)
+                coro::slab_handler([current, &has_error](const boost::system::error_code& error, std::size_t)
                 {
                     if(error)
                     {
@@ -39,7 +60,7 @@ public:
                         has_error  = true;
                     }
                     coro::this_coroutine::detail::jump(current);
-                }
+                })
                 );
 
         coro::this_coroutine::suspend();
@@ -48,13 +69,13 @@ public:
         return std::string(buf.data());
     }
 
-    void send(std::string data)
+    void send(const std::string& data)
     {
         auto current = coro::this_coroutine::detail::current;
         boost::asio::async_write(
                 socket_,
                 boost::asio::buffer(data),
-                [current](const boost::system::error_code& error, std::size_t)
+                coro::slab_handler([current](const boost::system::error_code& error, std::size_t)
                 {
                     if(error)
                     {
@@ -64,15 +85,323 @@ public:
                     {
                         coro::this_coroutine::detail::jump(current);
                     }
-                }
+                })
                 );
 
         coro::this_coroutine::suspend();
     }
 
+    // length prefixed frames: a 4 byte big endian body size, then the body.
+    // `data` points into the read buffer of the connection, which is reused
+    // for every frame, and stays valid until the next recv_frame.
+    // false on error, eof, or a frame larger than `max_size`.
+    bool recv_frame(const char*& data, std::size_t& size, std::size_t max_size = 16 * 1024 * 1024)
+    {
+        if(!fill(4)) return false;
+        if(!frame_size(size, max_size)) return false;
+        if(!fill(4 + size)) return false;
+
+        take_frame(data, size);
+        return true;
+    }
+
+    // header and body go out in one gathered write
+    bool send_frame(const char* data, std::size_t size)
+    {
+        std::array<unsigned char, 4> header = frame_header(size);
+        std::array<boost::asio::const_buffer, 2> buffers = {
+            boost::asio::buffer(header),
+            boost::asio::buffer(data, size),
+        };
+
+        auto current = coro::this_coroutine::detail::current;
+        bool has_error = false;
+        boost::asio::async_write(
+                socket_,
+                buffers,
+                coro::slab_handler([current, &has_error](const boost::system::error_code& error, std::size_t)
+                {
+                    if(error)
+                    {
+                        std::cout << "send error: " << error << std::endl;
+                        has_error = true;
+                    }
+                    coro::this_coroutine::detail::jump(current);
+                })
+                );
+
+        coro::this_coroutine::suspend();
+        return !has_error;
+    }
+
+    bool send_frame(const std::string& data)
+    {
+        return send_frame(data.data(), data.size());
+    }
+
+    // awaitable versions for stackless tasks (coro_task.h):
+    //   std::string data = co_await client->async_recv(1024);
+    //   bool ok = co_await client->async_send(data);
+    // the same results as recv/send. the awaiters keep their buffers
+    // in the task's frame while the io is pending.
+
+    // up to buffer size bytes, 0 on error or eof
+    struct ReadAwaiter
+    {
+        Connection* conn;
+        char* p;
+        std::size_t size;
+        std::size_t got;
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        template<class Handle>
+        void await_suspend(Handle h)
+        {
+            auto w = coro::Waiter::from_handle(h);
+            auto self = this;
+            conn->socket_.async_read_some(
+                    boost::asio::buffer(p, size),
+                    coro::slab_handler([w, self](const boost::system::error_code& error, std::size_t n)
+                    {
+                        if(error && error != boost::asio::error::eof && error != boost::asio::error::connection_reset)
+                        {
+                            std::cout << "recv error: " << error << std::endl;
+                        }
+                        self->got = error ? 0 : n;
+                        w.wake();
+                    })
+                    );
+        }
+
+        std::size_t await_resume() const
+        {
+            return got;
+        }
+    };
+
+    ReadAwaiter async_read_some(char* p, std::size_t size)
+    {
+        return ReadAwaiter{this, p, size, 0};
+    }
+
+    struct RecvAwaiter
+    {
+        ReadAwaiter read;
+        std::array<char, 1024> buf;
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        template<class Handle>
+        void await_suspend(Handle h)
+        {
+            read.p = buf.data();
+            read.size = buf.size();
+            read.await_suspend(h);
+        }
+
+        std::string await_resume() const
+        {
+            return std::string(buf.data(), read.got);
+        }
+    };
+
+    RecvAwaiter async_recv(const std::size_t&)
+    {
+        return RecvAwaiter{ReadAwaiter{this, NULL, 0, 0}, {}};
+    }
+
+    // writes the whole `data`, or the header and body of a frame
+    struct WriteAwaiter
+    {
+        Connection* conn;
+        std::string data;
+        const char* body;
+        std::size_t body_size;
+        std::array<unsigned char, 4> header;
+        bool framed;
+        bool ok;
+
+        bool await_ready() const
+        {
+            return false;
+        }
+
+        template<class Handle>
+        void await_suspend(Handle h)
+        {
+            auto w = coro::Waiter::from_handle(h);
+            auto self = this;
+            auto done = coro::slab_handler([w, self](const boost::system::error_code& error, std::size_t)
+            {
+                if(error)
+                {
+                    std::cout << "send error: " << error << std::endl;
+                }
+                self->ok = !error;
+                w.wake();
+            });
+
+            if(framed)
+            {
+                std::array<boost::asio::const_buffer, 2> buffers = {
+                    boost::asio::buffer(header),
+                    boost::asio::buffer(body, body_size),
+                };
+                boost::asio::async_write(conn->socket_, buffers, done);
+            }
+            else
+            {
+                boost::asio::async_write(conn->socket_, boost::asio::buffer(data), done);
+            }
+        }
+
+        bool await_resume() const
+        {
+            return ok;
+        }
+    };
+
+    WriteAwaiter async_send(std::string data)
+    {
+        return WriteAwaiter{this, std::move(data), NULL, 0, {}, false, false};
+    }
+
+    // `data` is not copied, keep it until the send is done
+    WriteAwaiter async_send_frame(const char* data, std::size_t size)
+    {
+        return WriteAwaiter{this, std::string(), data, size, frame_header(size), true, false};
+    }
+
+    WriteAwaiter async_send_frame(const std::string& data)
+    {
+        return async_send_frame(data.data(), data.size());
+    }
+
+#ifdef __cpp_impl_coroutine
+    // recv_frame for stackless tasks
+    coro::task<bool> async_recv_frame(const char*& data, std::size_t& size, std::size_t max_size = 16 * 1024 * 1024)
+    {
+        bool ok = co_await async_fill(4);
+        if(!ok || !frame_size(size, max_size)) co_return false;
+        ok = co_await async_fill(4 + size);
+        if(!ok) co_return false;
+
+        take_frame(data, size);
+        co_return true;
+    }
+#endif
+
 
 private:
+    // at least `need` unread bytes in rbuf_
+    bool fill(std::size_t need)
+    {
+        if(rend_ - rbegin_ >= need) return true;
+        make_room(need);
+
+        while(rend_ - rbegin_ < need)
+        {
+            std::size_t n = read_some(rbuf_.data() + rend_, rbuf_.size() - rend_);
+            if(n == 0) return false;
+            rend_ += n;
+        }
+        return true;
+    }
+
+#ifdef __cpp_impl_coroutine
+    coro::task<bool> async_fill(std::size_t need)
+    {
+        if(rend_ - rbegin_ >= need) co_return true;
+        make_room(need);
+
+        while(rend_ - rbegin_ < need)
+        {
+            std::size_t n = co_await async_read_some(rbuf_.data() + rend_, rbuf_.size() - rend_);
+            if(n == 0) co_return false;
+            rend_ += n;
+        }
+        co_return true;
+    }
+#endif
+
+    void make_room(std::size_t need)
+    {
+        if(rbegin_ + need > rbuf_.size())
+        {
+            // move the unread bytes to the front, grow for large frames
+            std::memmove(rbuf_.data(), rbuf_.data() + rbegin_, rend_ - rbegin_);
+            rend_ -= rbegin_;
+            rbegin_ = 0;
+            if(need > rbuf_.size()) rbuf_.resize(need);
+        }
+    }
+
+    // body size from the header at rbegin_
+    bool frame_size(std::size_t& size, std::size_t max_size) const
+    {
+        auto p = reinterpret_cast<const unsigned char*>(rbuf_.data() + rbegin_);
+        size = static_cast<std::size_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        if(size > max_size)
+        {
+            std::cout << "frame too large: " << size << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void take_frame(const char*& data, std::size_t size)
+    {
+        data = rbuf_.data() + rbegin_ + 4;
+        rbegin_ += 4 + size;
+    }
+
+    static std::array<unsigned char, 4> frame_header(std::size_t size)
+    {
+        uint32_t n = static_cast<uint32_t>(size);
+        return {
+            static_cast<unsigned char>(n >> 24),
+            static_cast<unsigned char>(n >> 16),
+            static_cast<unsigned char>(n >> 8),
+            static_cast<unsigned char>(n),
+        };
+    }
+
+    std::size_t read_some(char* p, std::size_t size)
+    {
+        auto current = coro::this_coroutine::detail::current;
+        std::size_t got = 0;
+
+        socket_.async_read_some(
+                boost::asio::buffer(p, size),
+                coro::slab_handler([current, &got](const boost::system::error_code& error, std::size_t n)
+                {
+                    // the peer going away is not worth a message
+                    if(error && error != boost::asio::error::eof && error != boost::asio::error::connection_reset)
+                    {
+                        std::cout << "recv error: " << error << std::endl;
+                    }
+                    got = error ? 0 : n;
+                    coro::this_coroutine::detail::jump(current);
+                })
+                );
+
+        coro::this_coroutine::suspend();
+        return got;
+    }
+
     tcp::socket socket_;
+
+    // frames are read into this buffer, [rbegin_, rend_) is not consumed yet
+    std::vector<char, coro::SlabAllocator<char>> rbuf_;
+    std::size_t rbegin_;
+    std::size_t rend_;
 };
 
 
@@ -94,7 +423,7 @@ public:
 
         socket.async_connect(
                 endpoint,
-                [current](const boost::system::error_code& error)
+                coro::slab_handler([current](const boost::system::error_code& error)
                 {
                     if(error)
                     {
@@ -104,12 +433,12 @@ public:
                     {
                         coro::this_coroutine::detail::jump(current);
                     }
-                }
+                })
         );
 
         coro::this_coroutine::suspend();
 
-        return std::make_shared<Connection>(std::move(socket));
+        return std::allocate_shared<Connection>(coro::SlabAllocator<Connection>(), std::move(socket));
     }
 };
 
@@ -120,17 +449,65 @@ public:
     Server(boost::asio::io_service& io, int port, std::function<void(Client)> callback)
         : io_(io),
           acceptor_(io, tcp::endpoint(tcp::v4(), port)),
-          accept_callback_(callback)
+          accept_callback_(callback),
+          batch_accept_(false),
+          spin_us_(0),
+          adaptive_spin_(false),
+          so_busy_poll_us_(0)
+    {
+        sche_ = coro::Scheduler::create(io_);
+    }
+
+#ifdef __cpp_impl_coroutine
+    // every connection is a stackless task instead of a stackful coroutine
+    Server(boost::asio::io_service& io, int port, std::function<coro::task<void>(Client)> callback, coro::stackless_t)
+        : io_(io),
+          acceptor_(io, tcp::endpoint(tcp::v4(), port)),
+          task_callback_(callback),
+          batch_accept_(false),
+          spin_us_(0),
+          adaptive_spin_(false),
+          so_busy_poll_us_(0)
     {
         sche_ = coro::Scheduler::create(io_);
     }
+#endif
+
+    // for bursts of connections: every wakeup accepts all the pending
+    // connections, spawns their handlers on `pool_size` prewarmed
+    // coroutines and runs none of them before all are queued.
+    // call before run()
+    void set_batch_accept(std::size_t pool_size)
+    {
+        batch_accept_ = true;
+        acceptor_.non_blocking(true);
+        sche_->prewarm(pool_size);
+    }
+
+    // run with Scheduler::run_busy_poll instead of io_service::run.
+    // `so_busy_poll_us` > 0 also sets SO_BUSY_POLL on every connection:
+    // a blocking read spins in the driver that long (only NICs with
+    // NAPI, not loopback; above net.core.busy_read needs CAP_NET_ADMIN)
+    void set_busy_poll(int max_spin_us, bool adaptive, int so_busy_poll_us = 0)
+    {
+        spin_us_ = max_spin_us;
+        adaptive_spin_ = adaptive;
+        so_busy_poll_us_ = so_busy_poll_us;
+    }
 
     void run()
     {
         sche_->spawn(std::bind(&Server::accept_loop, this), std::string("accept_loop"));
 
         sche_->run();
-        io_.run();
+        if(spin_us_ > 0)
+        {
+            sche_->run_busy_poll(spin_us_, adaptive_spin_);
+        }
+        else
+        {
+            io_.run();
+        }
     }
 
 private:
@@ -142,7 +519,7 @@ private:
             tcp::socket socket(io_);
             acceptor_.async_accept(
                     socket,
-                    [current](const boost::system::error_code& error)
+                    coro::slab_handler([current](const boost::system::error_code& error)
                     {
                         if(error)
                         {
@@ -153,21 +530,65 @@ private:
                         {
                             coro::this_coroutine::detail::jump(current);
                         }
-                    }
+                    })
                     );
 
             coro::this_coroutine::suspend();
 
-            Client client = std::make_shared<Connection>(std::move(socket));
-            std::function<void()> handler = std::bind(accept_callback_, client);
-            sche_->spawn(handler, std::string("client"));
+            if(!batch_accept_)
+            {
+                spawn_client(std::move(socket));
+                continue;
+            }
+
+            sche_->batch_begin();
+            spawn_client(std::move(socket));
+            // the rest of the backlog, until the acceptor would block
+            for(;;)
+            {
+                tcp::socket more(io_);
+                boost::system::error_code error;
+                acceptor_.accept(more, error);
+                if(error) break;
+                spawn_client(std::move(more));
+            }
+            sche_->batch_end();
+        }
+    }
+
+    void spawn_client(tcp::socket socket)
+    {
+#ifdef SO_BUSY_POLL
+        if(so_busy_poll_us_ > 0
+                && setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &so_busy_poll_us_, sizeof(so_busy_poll_us_)) != 0)
+        {
+            std::cout << "SO_BUSY_POLL: " << std::strerror(errno) << std::endl;
+            so_busy_poll_us_ = 0;
+        }
+#endif
+        Client client = std::allocate_shared<Connection>(coro::SlabAllocator<Connection>(), std::move(socket));
+#ifdef __cpp_impl_coroutine
+        if(task_callback_)
+        {
+            coro::spawn_task(task_callback_(client), std::string("client"));
+            return;
         }
+#endif
+        // straight into spawn's parameter, one std::function and no copy
+        sche_->spawn(std::bind(accept_callback_, std::move(client)), std::string("client"));
     }
 
     boost::asio::io_service& io_;
     tcp::acceptor acceptor_;
     std::function<void(Client)> accept_callback_;
+#ifdef __cpp_impl_coroutine
+    std::function<coro::task<void>(Client)> task_callback_;
+#endif
     coro::Scheduler* sche_;
+    bool batch_accept_;
+    int spin_us_;
+    bool adaptive_spin_;
+    int so_busy_poll_us_;
 };
 
 
@@ -0,0 +1,71 @@
+#define CORO_QUIET
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <boost/asio.hpp>
+
+#include "coro.h"
+
+// computes for `ms` without giving up the cpu
+void busy(int ms)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while(std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+// well behaved: short slices, yields in between
+void worker()
+{
+    for(int i=0; i<200; i++)
+    {
+        busy(1);
+        coro::this_coroutine::yield();
+    }
+}
+
+// stalls every other coroutine for 30ms at a time.
+// noinline so it is a frame of its own at -O2
+__attribute__((noinline)) void parse_huge_request()
+{
+    busy(30);
+}
+
+void hog()
+{
+    for(int i=0; i<3; i++)
+    {
+        coro::this_coroutine::sleep_for(1);
+        parse_huge_request();
+    }
+}
+
+void report()
+{
+    coro::this_coroutine::sleep_for(4);
+    coro::Scheduler::get()->profile_report(std::cout, 5);
+    exit(0);
+}
+
+
+int main()
+{
+    boost::asio::io_service io;
+    boost::asio::io_service::work w(io);
+
+    auto sche = coro::Scheduler::create(io);
+    sche->enable_profiling(10);
+
+    for(int i=0; i<3; i++)
+    {
+        sche->spawn(worker, std::string("worker"));
+    }
+    sche->spawn(hog, std::string("hog"));
+    sche->spawn(report, std::string("report"));
+
+    sche->run();
+    io.run();
+    return 0;
+}
@@ -0,0 +1,432 @@
+#define CORO_QUIET
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <boost/asio.hpp>
+#include <sys/resource.h>
+
+#include "coro_echo_server.h"
+#include "protocol_codec.h"
+#include "alloc_counter.h"
+
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// a json body starts with '{', which is not a valid first byte of a
+// protobuf Person (field 15, start group), so one port serves both
+bool is_json(const char* data, std::size_t size)
+{
+    return size > 0 && data[0] == '{';
+}
+
+template<class M>
+bool decode(const char* data, std::size_t size, bool json, M& out)
+{
+    return json ? codec::json_decode(data, size, out) : codec::pb_decode(data, size, out);
+}
+
+// into `out`, which keeps its capacity between calls
+template<class M>
+void encode(const M& m, bool json, std::string& out)
+{
+    out.resize(json ? codec::json_size(m) : codec::pb_size(m));
+    char* end = json ? codec::json_encode(m, &out[0]) : codec::pb_encode(m, &out[0]);
+    out.resize(end - out.data());
+}
+
+
+struct ServerStats
+{
+    std::size_t connections;
+    std::size_t requests;
+    std::size_t errors;
+    double decode_seconds;
+    double encode_seconds;
+    // operator new calls inside the codec's decode, see allocs/req
+    std::size_t decode_allocs;
+};
+
+ServerStats server_stats;
+
+
+// decode the Person, touch a few fields, reply with a Log that sums
+// them up in the same format. `person`, `reply` and `out` are reused
+// for every request of a connection
+bool handle_request(const char* data, std::size_t size, codec::Person& person, codec::Log& reply, std::string& out)
+{
+    bool json = is_json(data, size);
+
+    auto start = Clock::now();
+    std::size_t allocs = allocations();
+    if(!decode(data, size, json, person))
+    {
+        server_stats.errors++;
+        return false;
+    }
+    server_stats.decode_seconds += seconds_since(start);
+    server_stats.decode_allocs += allocations() - allocs;
+
+    reply.id = person.id;
+    reply.content = person.name;
+    reply.status = static_cast<int32_t>(person.logs.size());
+    reply.times = 0;
+    for(auto& log: person.logs)
+    {
+        reply.times += log.times;
+    }
+
+    start = Clock::now();
+    encode(reply, json, out);
+    server_stats.encode_seconds += seconds_since(start);
+    return true;
+}
+
+// one stackful coroutine per connection
+void rpc_handler(Client client)
+{
+    server_stats.connections++;
+    codec::Person person;
+    codec::Log reply;
+    std::string out;
+
+    const char* data;
+    std::size_t size;
+    while(client->recv_frame(data, size))
+    {
+        if(!handle_request(data, size, person, reply, out)) break;
+        if(!client->send_frame(out)) break;
+        server_stats.requests++;
+    }
+}
+
+#ifdef __cpp_impl_coroutine
+// one stackless task per connection, the same work
+coro::task<void> rpc_task(Client client)
+{
+    server_stats.connections++;
+    codec::Person person;
+    codec::Log reply;
+    std::string out;
+
+    const char* data;
+    std::size_t size;
+    for(;;)
+    {
+        bool ok = co_await client->async_recv_frame(data, size);
+        if(!ok || !handle_request(data, size, person, reply, out)) break;
+        ok = co_await client->async_send_frame(out);
+        if(!ok) break;
+        server_stats.requests++;
+    }
+}
+#endif
+
+// user + system time of this process
+double cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// rounded to 0.01, the report's own timer is not worth a digit
+double per_request(std::size_t count, std::size_t requests)
+{
+    return requests ? std::round(count * 100.0 / requests) / 100 : 0;
+}
+
+void server_report(bool busy_poll)
+{
+    ServerStats last = server_stats;
+    coro::PollStats last_poll = coro::Scheduler::get()->poll_stats();
+    double last_cpu = cpu_seconds();
+    std::size_t last_allocs = allocations();
+    for(;;)
+    {
+        coro::this_coroutine::sleep_for(1);
+
+        ServerStats now = server_stats;
+        std::size_t n = now.requests - last.requests;
+        double per = n ? 1e6 / n : 0;
+        double cpu = cpu_seconds();
+        // everything but decode: the connection, its io and the handler.
+        // decode rebuilds the Log strings of the Person every time
+        std::size_t allocs = allocations();
+        std::size_t decode_allocs = now.decode_allocs - last.decode_allocs;
+        std::cout << "conn/s: " << now.connections - last.connections
+                  << ", req/s: " << n
+                  << ", decode us/req: " << (now.decode_seconds - last.decode_seconds) * per
+                  << ", encode us/req: " << (now.encode_seconds - last.encode_seconds) * per
+                  << ", allocs/req: " << per_request(allocs - last_allocs - decode_allocs, n)
+                  << ", decode allocs/req: " << per_request(decode_allocs, n)
+                  << ", errors: " << now.errors
+                  << ", coroutines: " << coro::Scheduler::get()->size()
+                  << ", cpu: " << static_cast<int>((cpu - last_cpu) * 100) << "%";
+
+        coro::PollStats poll = coro::Scheduler::get()->poll_stats();
+        if(busy_poll)
+        {
+            std::cout << ", spin hits: " << poll.spin_hits - last_poll.spin_hits
+                      << ", blocks: " << poll.blocks - last_poll.blocks
+                      << ", spin ms: " << (poll.spin_seconds - last_poll.spin_seconds) * 1000
+                      << ", budget us: " << poll.budget_us;
+        }
+        std::cout << std::endl;
+        last = now;
+        last_poll = poll;
+        last_cpu = cpu;
+        last_allocs = allocs;
+    }
+}
+
+
+struct ClientStats
+{
+    std::size_t requests;
+    std::size_t errors;
+    // microseconds of every request
+    std::vector<double> latency;
+};
+
+ClientStats client_stats;
+
+// one request and its reply, timed from `start`
+void round_trip(Client& c, const std::string& request, int log_amount, Clock::time_point start)
+{
+    const char* data;
+    std::size_t size;
+    if(!c->send_frame(request) || !c->recv_frame(data, size))
+    {
+        std::cout << "server connection lost" << std::endl;
+        exit(1);
+    }
+    client_stats.latency.push_back(seconds_since(start) * 1e6);
+
+    codec::Log reply;
+    if(!decode(data, size, is_json(data, size), reply) || reply.status != log_amount)
+    {
+        client_stats.errors++;
+    }
+    client_stats.requests++;
+}
+
+// closed loop: one request in flight per connection
+void load_client(int port, const std::string* request, int log_amount)
+{
+    Client c = Endpoint::connect(coro::Scheduler::get()->io_service(), std::string("127.0.0.1"), port);
+    for(;;)
+    {
+        round_trip(c, *request, log_amount, Clock::now());
+    }
+}
+
+// a new connection for every request, like every client reconnecting
+// at once after a restart. the latency includes the connect
+void storm_client(int port, const std::string* request, int log_amount)
+{
+    for(;;)
+    {
+        auto start = Clock::now();
+        Client c = Endpoint::connect(coro::Scheduler::get()->io_service(), std::string("127.0.0.1"), port);
+        round_trip(c, *request, log_amount, start);
+    }
+}
+
+double percentile(std::vector<double>& sorted, double p)
+{
+    if(sorted.empty()) return 0;
+    return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+}
+
+void client_report(int seconds)
+{
+    std::size_t last = 0;
+    auto start = Clock::now();
+    for(int i=0; i<seconds; i++)
+    {
+        coro::this_coroutine::sleep_for(1);
+        std::cout << "req/s: " << client_stats.requests - last << std::endl;
+        last = client_stats.requests;
+    }
+
+    auto& latency = client_stats.latency;
+    std::sort(latency.begin(), latency.end());
+    std::cout << "Requests          : " << client_stats.requests << std::endl;
+    std::cout << "Req/s             : " << client_stats.requests / seconds_since(start) << std::endl;
+    std::cout << "Latency p50 us    : " << percentile(latency, 0.5) << std::endl;
+    std::cout << "Latency p99 us    : " << percentile(latency, 0.99) << std::endl;
+    std::cout << "Latency max us    : " << percentile(latency, 1) << std::endl;
+    std::cout << "Errors            : " << client_stats.errors << std::endl;
+    exit(0);
+}
+
+std::string make_request(bool json, int log_amount)
+{
+    codec::Person person;
+    person.id = 1;
+    person.name = "My Playground!!!";
+    for(int i=0; i<20; i++)
+    {
+        person.tags.push_back(i);
+    }
+    for(int i=0; i<log_amount; i++)
+    {
+        person.logs.push_back(codec::Log{i, "Log Contents..." + std::to_string(i), i % 2, 10000000 + i});
+    }
+
+    std::string out;
+    encode(person, json, out);
+    return out;
+}
+
+
+void report_on_signal(boost::asio::signal_set& signals)
+{
+    signals.async_wait(
+            [&signals](const boost::system::error_code& error, int)
+            {
+                if(error) return;
+                coro::Scheduler::get()->profile_report(std::cout, 10);
+                report_on_signal(signals);
+            }
+            );
+}
+
+
+void usage()
+{
+    std::cout << "usage: ./coro_rpc_server server [PORT] [stackless] [batch] [spin|adaptive-spin] [profile]" << std::endl;
+    std::cout << "       ./coro_rpc_server client|storm pb|json [CONNECTIONS] [SECONDS] [LOG AMOUNT] [PORT]" << std::endl;
+    exit(1);
+}
+
+int to_int(const char* s)
+{
+    try
+    {
+        return std::stoi(s);
+    }
+    catch(const std::exception&)
+    {
+        usage();
+    }
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    if(argc < 2) usage();
+    std::string mode = argv[1];
+
+    boost::asio::io_service io;
+    boost::asio::io_service::work w(io);
+
+    if(mode == "server")
+    {
+        int port = argc > 2 ? to_int(argv[2]) : 9092;
+        bool stackless = false;
+        bool batch = false;
+        int spin_us = 0;
+        bool adaptive = false;
+        boost::asio::signal_set signals(io);
+        for(int i=3; i<argc; i++)
+        {
+            std::string option = argv[i];
+            if(option == "stackless")
+            {
+                stackless = true;
+            }
+            else if(option == "batch")
+            {
+                batch = true;
+            }
+            else if(option == "spin" || option == "adaptive-spin")
+            {
+                // up to 50us, SO_BUSY_POLL as long (a no-op on loopback)
+                spin_us = 50;
+                adaptive = option == "adaptive-spin";
+            }
+            else if(option == "profile")
+            {
+                // kill -USR1 prints the coroutines that used the most cpu
+                coro::Scheduler::create(io)->enable_profiling(10);
+                signals.add(SIGUSR1);
+                report_on_signal(signals);
+            }
+            else
+            {
+                usage();
+            }
+        }
+
+        std::unique_ptr<Server> s;
+#ifdef __cpp_impl_coroutine
+        if(stackless)
+        {
+            s.reset(new Server(io, port, rpc_task, coro::stackless));
+        }
+#else
+        if(stackless)
+        {
+            std::cout << "stackless handlers need -std=c++20" << std::endl;
+            return 1;
+        }
+#endif
+        if(!s)
+        {
+            s.reset(new Server(io, port, rpc_handler));
+        }
+        if(batch)
+        {
+            s->set_batch_accept(256);
+        }
+        if(spin_us)
+        {
+            s->set_busy_poll(spin_us, adaptive, spin_us);
+        }
+
+        coro::Scheduler::get()->spawn(std::bind(server_report, spin_us > 0), std::string("report"));
+        s->run();
+        return 0;
+    }
+
+    if((mode != "client" && mode != "storm") || argc < 3) usage();
+    std::string format = argv[2];
+    if(format != "pb" && format != "json") usage();
+
+    int connections = argc > 3 ? to_int(argv[3]) : 16;
+    int seconds = argc > 4 ? to_int(argv[4]) : 10;
+    int log_amount = argc > 5 ? to_int(argv[5]) : 100;
+    int port = argc > 6 ? to_int(argv[6]) : 9092;
+    if(connections <= 0 || seconds <= 0 || log_amount < 0) usage();
+    auto client = mode == "storm" ? storm_client : load_client;
+
+    std::string request = make_request(format == "json", log_amount);
+    std::cout << "Request Size      : " << request.size() << std::endl;
+    std::cout << "Connections       : " << connections << std::endl;
+
+    client_stats.latency.reserve(1 << 20);
+
+    auto sche = coro::Scheduler::create(io);
+    for(int i=0; i<connections; i++)
+    {
+        sche->spawn(std::bind(client, port, &request, log_amount), mode);
+    }
+    sche->spawn(std::bind(client_report, seconds), std::string("report"));
+
+    sche->run();
+    io.run();
+    return 0;
+}
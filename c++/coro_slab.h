@@ -0,0 +1,249 @@
+#ifndef __CORO_SLAB_H__
+#define __CORO_SLAB_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// per-thread recycling of memory blocks for connection objects, their
+// read buffers, stackless task frames and asio completion handlers.
+//
+// a request is rounded up to a power of two size class, 16 bytes to
+// 64KB. a freed block goes on the free list of its class on the freeing
+// thread, and the next allocation of that class on the thread takes it
+// from there instead of calling operator new, so a server that keeps
+// the same connections busy stops allocating after the first requests.
+// larger blocks, and blocks beyond max_free per class, go back to
+// operator delete. a block freed on another thread joins that thread's
+// lists, no locks anywhere.
+namespace coro
+{
+
+struct SlabStats
+{
+    // allocations served from a free list, and by operator new
+    uint64_t hits;
+    uint64_t misses;
+};
+
+class Slab
+{
+public:
+    static constexpr std::size_t min_size = 16;
+    static constexpr std::size_t max_size = 64 * 1024;
+    static constexpr std::size_t max_free = 256;
+
+    static void* allocate(std::size_t size)
+    {
+        auto& s = state();
+        int c = size_class(size);
+        if (c >= 0 && s.free[c])
+        {
+            Block* b = s.free[c];
+            s.free[c] = b->next;
+            s.count[c]--;
+            s.stats.hits++;
+            return b;
+        }
+
+        s.stats.misses++;
+        return ::operator new(c >= 0 ? class_size(c) : size);
+    }
+
+    // `size` is what was asked for in allocate
+    static void deallocate(void* p, std::size_t size)
+    {
+        if (!p) return;
+        auto& s = state();
+        int c = size_class(size);
+        if (c < 0 || s.closed || s.count[c] >= max_free)
+        {
+            ::operator delete(p);
+            return;
+        }
+
+        reaper();
+        Block* b = static_cast<Block*>(p);
+        b->next = s.free[c];
+        s.free[c] = b;
+        s.count[c]++;
+    }
+
+    // of the calling thread
+    static SlabStats stats()
+    {
+        return state().stats;
+    }
+
+private:
+    static constexpr int classes = 13;
+
+    struct Block
+    {
+        Block* next;
+    };
+
+    // trivially destructible, so it is still there for blocks freed
+    // by thread_local and static destructors that run after reaper's
+    struct State
+    {
+        Block* free[classes];
+        std::size_t count[classes];
+        SlabStats stats;
+        bool closed;
+    };
+
+    // hands the cached blocks back when the thread exits
+    struct Reaper
+    {
+        ~Reaper()
+        {
+            auto& s = state();
+            s.closed = true;
+            for (int c = 0; c < classes; c++)
+            {
+                while (s.free[c])
+                {
+                    Block* b = s.free[c];
+                    s.free[c] = b->next;
+                    ::operator delete(b);
+                }
+                s.count[c] = 0;
+            }
+        }
+    };
+
+    static State& state()
+    {
+        static thread_local State s;
+        return s;
+    }
+
+    static void reaper()
+    {
+        static thread_local Reaper r;
+        (void)r;
+    }
+
+    // -1 above max_size
+    static int size_class(std::size_t size)
+    {
+        if (size <= min_size) return 0;
+        if (size > max_size) return -1;
+        return 64 - __builtin_clzll(size - 1) - 4;
+    }
+
+    static std::size_t class_size(int c)
+    {
+        return min_size << c;
+    }
+};
+
+// a std allocator on the slab, for std::allocate_shared and containers
+template<class T>
+struct SlabAllocator
+{
+    typedef T value_type;
+
+    static_assert(alignof(T) <= alignof(std::max_align_t), "slab blocks have operator new's alignment");
+
+    SlabAllocator() noexcept
+    {
+    }
+
+    template<class U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(Slab::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        Slab::deallocate(p, n * sizeof(T));
+    }
+};
+
+// what SlabHandler hands to asio as its associated allocator, asio
+// rebinds it to the operation it allocates
+template<>
+struct SlabAllocator<void>
+{
+    typedef void value_type;
+
+    SlabAllocator() noexcept
+    {
+    }
+
+    template<class U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept
+    {
+    }
+};
+
+template<class T, class U>
+bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&)
+{
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&)
+{
+    return false;
+}
+
+// wraps an asio completion handler so the operation that carries it
+// (and every step of a composed one like async_write) is allocated on
+// the slab, through asio's associated allocator, and through the older
+// handler allocation hooks for asio versions that still call them:
+//   socket.async_read_some(buffer, coro::slab_handler([...](...) {...}));
+template<class Handler>
+class SlabHandler
+{
+public:
+    typedef SlabAllocator<void> allocator_type;
+
+    explicit SlabHandler(Handler h) :
+            handler_(std::move(h))
+    {
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type();
+    }
+
+    template<class... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+    friend void* asio_handler_allocate(std::size_t size, SlabHandler*)
+    {
+        return Slab::allocate(size);
+    }
+
+    friend void asio_handler_deallocate(void* p, std::size_t size, SlabHandler*)
+    {
+        Slab::deallocate(p, size);
+    }
+
+private:
+    Handler handler_;
+};
+
+template<class Handler>
+SlabHandler<Handler> slab_handler(Handler h)
+{
+    return SlabHandler<Handler>(std::move(h));
+}
+
+}
+
+#endif // __CORO_SLAB_H__
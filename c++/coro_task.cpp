@@ -0,0 +1,69 @@
+#define CORO_QUIET
+
+#include <iostream>
+#include <string>
+#include <functional>
+
+#include "coro_task.h"
+
+
+coro::task<int> add_later(int a, int b)
+{
+    std::cout << "[add_later] sleep" << std::endl;
+    co_await coro::async_sleep_for(1);
+    co_return a + b;
+}
+
+// a stackless task awaits another task, an event and a queue
+coro::task<void> consumer(coro::Event& evt, coro::Queue<int>& queue)
+{
+    int sum = co_await add_later(1, 2);
+    std::cout << "[consumer] 1 + 2 = " << sum << std::endl;
+
+    co_await evt.async_wait();
+    std::cout << "[consumer] event set" << std::endl;
+
+    for(;;)
+    {
+        int value = co_await queue.async_get();
+        std::cout << "[consumer] get value: " << value << std::endl;
+        if(value == 3) break;
+    }
+}
+
+// a stackful coroutine sets the event, feeds the queue and waits for a task
+void producer(coro::Event& evt, coro::Queue<int>& queue)
+{
+    coro::this_coroutine::sleep_for(2);
+    std::cout << "[producer] set event" << std::endl;
+    evt.set();
+
+    for(int i=1; i<=3; i++)
+    {
+        queue.put(i);
+        coro::this_coroutine::sleep_for(1);
+    }
+
+    int sum = coro::this_coroutine::await(add_later(3, 4));
+    std::cout << "[producer] 3 + 4 = " << sum << std::endl;
+    std::cout << "[producer] coroutines and tasks left: " << coro::Scheduler::get()->size() << std::endl;
+    exit(0);
+}
+
+
+int main()
+{
+    boost::asio::io_service io;
+    boost::asio::io_service::work w(io);
+
+    coro::Event evt;
+    coro::Queue<int> queue;
+    auto sche = coro::Scheduler::create(io);
+
+    coro::spawn_task(consumer(evt, queue), std::string("consumer"));
+    sche->spawn(std::bind(producer, std::ref(evt), std::ref(queue)), std::string("producer"));
+
+    sche->run();
+    io.run();
+    return 0;
+}
@@ -0,0 +1,369 @@
+#ifndef __CORO_TASK_H__
+#define __CORO_TASK_H__
+
+#if !defined(__cpp_impl_coroutine)
+#error "coro_task.h needs C++20 coroutines (-std=c++20)"
+#endif
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <coroutine>
+
+#include "coro.h"
+#include "coro_slab.h"
+
+// stackless coroutines for coro.
+//
+// a task<T> is a C++20 coroutine: its frame holds only the locals that
+// live across a co_await, usually a few hundred bytes, instead of a
+// whole stack like coro::spawn. it can co_await
+//   other tasks                       co_await child(...)
+//   Event / Queue                     co_await evt.async_wait(), queue.async_get()
+//   timers                            co_await coro::async_sleep_for(seconds)
+//   Connection io                     co_await client->async_recv_frame(...)
+// a stackless task can not call the blocking versions (wait(), get(),
+// sleep_for(), recv()...), those suspend the stackful coroutine it
+// happens to run on. a stackful coroutine waits for a task with
+// coro::this_coroutine::await(task).
+//
+// tasks start when awaited, coro::spawn_task runs one on the Scheduler.
+namespace coro
+{
+
+template<class T = void>
+class task;
+
+namespace detail
+{
+
+struct task_promise_base
+{
+    // who co_awaits this task, resumed when it finishes
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    // frames come from the per-thread slab, a task per request or per
+    // read does not reach malloc
+    static void* operator new(std::size_t size)
+    {
+        return Slab::allocate(size);
+    }
+
+    static void operator delete(void* p, std::size_t size)
+    {
+        Slab::deallocate(p, size);
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    final_awaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        error = std::current_exception();
+    }
+};
+
+template<class T>
+struct task_promise: task_promise_base
+{
+    std::optional<T> value;
+
+    task<T> get_return_object();
+
+    template<class V>
+    void return_value(V&& v)
+    {
+        value.emplace(std::forward<V>(v));
+    }
+
+    T result()
+    {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template<>
+struct task_promise<void>: task_promise_base
+{
+    task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void result()
+    {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// frees itself at the end, for tasks nobody co_awaits
+struct detached
+{
+    struct promise_type
+    {
+        static void* operator new(std::size_t size)
+        {
+            return Slab::allocate(size);
+        }
+
+        static void operator delete(void* p, std::size_t size)
+        {
+            Slab::deallocate(p, size);
+        }
+
+        detached get_return_object()
+        {
+            return detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+}
+
+template<class T>
+class task
+{
+public:
+    typedef detail::task_promise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    task() :
+            h_(nullptr)
+    {
+    }
+
+    explicit task(handle_type h) :
+            h_(h)
+    {
+    }
+
+    task(task&& other) noexcept :
+            h_(std::exchange(other.h_, nullptr))
+    {
+    }
+
+    task& operator=(task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (h_) h_.destroy();
+            h_ = std::exchange(other.h_, nullptr);
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task()
+    {
+        if (h_) h_.destroy();
+    }
+
+    bool done() const
+    {
+        return !h_ || h_.done();
+    }
+
+    // starts the task, the awaiting coroutine continues when it is done
+    // (symmetric transfer, no stack grows on either side)
+    auto operator co_await() noexcept
+    {
+        struct awaiter
+        {
+            handle_type h;
+
+            bool await_ready() noexcept
+            {
+                return !h || h.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                h.promise().continuation = awaiting;
+                return h;
+            }
+
+            T await_resume()
+            {
+                return h.promise().result();
+            }
+        };
+        return awaiter{h_};
+    }
+
+    // like co_await, but does not take the result or rethrow
+    auto when_ready() noexcept
+    {
+        struct awaiter
+        {
+            handle_type h;
+
+            bool await_ready() noexcept
+            {
+                return !h || h.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                h.promise().continuation = awaiting;
+                return h;
+            }
+
+            void await_resume() noexcept
+            {
+            }
+        };
+        return awaiter{h_};
+    }
+
+    // after it is done
+    T result()
+    {
+        return h_.promise().result();
+    }
+
+private:
+    handle_type h_;
+};
+
+namespace detail
+{
+
+template<class T>
+task<T> task_promise<T>::get_return_object()
+{
+    return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object()
+{
+    return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+inline detached run_task(task<void> t, std::string name)
+{
+    try
+    {
+        co_await t;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "[task] " << name << " error: " << e.what() << std::endl;
+    }
+    Scheduler::get()->task_finished();
+}
+
+template<class T>
+detached wake_when_ready(task<T>& t, bool& done, bool& waiting, Coroutine* co)
+{
+    co_await t.when_ready();
+    done = true;
+    if (waiting)
+    {
+        this_coroutine::detail::jump(co);
+    }
+}
+
+}
+
+// tag for the constructors that take stackless handlers
+struct stackless_t
+{
+};
+
+constexpr stackless_t stackless{};
+
+// runs `t` on the Scheduler next to the stackful coroutines,
+// its frame is freed when it finishes
+inline void spawn_task(task<void> t, std::string name)
+{
+    auto sche = Scheduler::get();
+    sche->task_started();
+    sche->schedule(Waiter::from_handle(detail::run_task(std::move(t), name).handle));
+}
+
+namespace this_coroutine
+{
+
+// from a stackful coroutine: runs `t` and suspends until it is done
+template<class T>
+T await(task<T> t)
+{
+    auto current = detail::current;
+    if (!current)
+    {
+        std::cout << "ERROR can not await in main context" << std::endl;
+        exit(1);
+    }
+
+    bool done = false;
+    bool waiting = false;
+    coro::detail::wake_when_ready(t, done, waiting, current).handle.resume();
+
+    // a task that never suspended is done already
+    if (!done)
+    {
+        waiting = true;
+        current->suspend();
+    }
+    return t.result();
+}
+
+}
+
+}
+
+#endif // __CORO_TASK_H__
@@ -0,0 +1,55 @@
+#define CORO_QUIET
+
+#include <iostream>
+#include <string>
+#include <boost/asio.hpp>
+
+#include "coro_udp_server.h"
+
+
+void datagram_handler(Datagram& dgram)
+{
+    dgram.reply(dgram.data(), dgram.size());
+}
+
+
+// per second: packets, recvmmsg/sendmmsg calls and packets per call
+void report(UdpServer& server)
+{
+    UdpStats last = server.stats();
+    for(;;)
+    {
+        coro::this_coroutine::sleep_for(1);
+
+        UdpStats now = server.stats();
+        std::size_t rx = now.rx_packets - last.rx_packets;
+        std::size_t tx = now.tx_packets - last.tx_packets;
+        std::size_t rx_calls = now.rx_calls - last.rx_calls;
+        std::size_t tx_calls = now.tx_calls - last.tx_calls;
+        std::cout << "rx pps: " << rx
+                  << ", tx pps: " << tx
+                  << ", rx calls: " << rx_calls
+                  << ", tx calls: " << tx_calls
+                  << ", rx pkts/call: " << (rx_calls ? static_cast<double>(rx) / rx_calls : 0)
+                  << ", tx pkts/call: " << (tx_calls ? static_cast<double>(tx) / tx_calls : 0)
+                  << ", drops: " << now.drops - last.drops
+                  << ", truncated: " << now.truncated - last.truncated << std::endl;
+        last = now;
+    }
+}
+
+
+int main()
+{
+    boost::asio::io_service io;
+    boost::asio::io_service::work w(io);
+
+    UdpServer s(io, 9091, datagram_handler);
+
+    auto sche = coro::Scheduler::create(io);
+    sche->spawn(std::bind(report, std::ref(s)), std::string("report"));
+
+    s.run();
+
+    return 0;
+}
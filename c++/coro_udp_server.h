@@ -0,0 +1,399 @@
+#ifndef __CORO_UDP_SERVER_H__
+#define __CORO_UDP_SERVER_H__
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <vector>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <boost/asio.hpp>
+
+#include "coro.h"
+
+using boost::asio::ip::udp;
+
+// one datagram, the buffer is owned by PacketPool and reused
+struct Packet
+{
+    static const std::size_t capacity = 2048;
+
+    std::array<char, capacity> data;
+    std::size_t size;
+    sockaddr_storage addr;
+    socklen_t addrlen;
+};
+
+
+class PacketPool
+{
+public:
+    PacketPool(std::size_t count)
+    {
+        storage_.reserve(count);
+        free_.reserve(count);
+        for(std::size_t i=0; i<count; i++)
+        {
+            storage_.emplace_back(new Packet);
+            free_.push_back(storage_.back().get());
+        }
+    }
+
+    Packet* acquire()
+    {
+        if(free_.empty()) return NULL;
+
+        auto p = free_.back();
+        free_.pop_back();
+        return p;
+    }
+
+    void release(Packet* p)
+    {
+        free_.push_back(p);
+    }
+
+    std::size_t available() const
+    {
+        return free_.size();
+    }
+
+private:
+    std::vector<std::unique_ptr<Packet>> storage_;
+    std::vector<Packet*> free_;
+};
+
+
+class UdpServer;
+
+// what the handler coroutine got.
+// the packet goes back to the pool when the handler returns,
+// copy the payload out if it must live longer.
+class Datagram
+{
+public:
+    Datagram(Packet* packet, UdpServer* server):
+        packet_(packet), server_(server)
+    {}
+
+    const char* data() const
+    {
+        return packet_->data.data();
+    }
+
+    std::size_t size() const
+    {
+        return packet_->size;
+    }
+
+    std::string str() const
+    {
+        return std::string(data(), size());
+    }
+
+    // queued, and sent together with other replies by one sendmmsg
+    void reply(const char* data, std::size_t size);
+
+    void reply(const std::string& data)
+    {
+        reply(data.data(), data.size());
+    }
+
+private:
+    Packet* packet_;
+    UdpServer* server_;
+};
+
+
+struct UdpStats
+{
+    std::size_t rx_packets;
+    std::size_t tx_packets;
+    std::size_t rx_calls;
+    std::size_t tx_calls;
+    std::size_t drops;
+    // larger than Packet::capacity, dropped
+    std::size_t truncated;
+};
+
+
+class UdpServer
+{
+public:
+    UdpServer(boost::asio::io_service& io, int port,
+            std::function<void(Datagram&)> callback,
+            std::size_t batch = 64, std::size_t workers = 4)
+        : io_(io),
+          socket_(io, udp::endpoint(udp::v4(), port)),
+          callback_(callback),
+          batch_(batch),
+          pool_(batch * (workers + 2)),
+          workers_(workers),
+          dispatching_(false),
+          flushing_(false),
+          stats_()
+    {
+        socket_.non_blocking(true);
+
+        rx_.resize(batch_);
+        rx_hdrs_.resize(batch_);
+        rx_iovs_.resize(batch_);
+        tx_hdrs_.resize(batch_);
+        tx_iovs_.resize(batch_);
+
+        sche_ = coro::Scheduler::create(io_);
+    }
+
+    void run()
+    {
+        for(auto& w: workers_)
+        {
+            sche_->spawn(std::bind(&UdpServer::worker_loop, this, std::ref(w)), std::string("udp_worker"));
+        }
+        sche_->spawn(std::bind(&UdpServer::recv_loop, this), std::string("udp_recv_loop"));
+
+        sche_->run();
+        io_.run();
+    }
+
+    const UdpStats& stats() const
+    {
+        return stats_;
+    }
+
+private:
+    friend class Datagram;
+
+    struct Worker
+    {
+        coro::Queue<Packet*> queue;
+    };
+
+    void wait(udp::socket::wait_type type)
+    {
+        auto current = coro::this_coroutine::detail::current;
+        socket_.async_wait(
+                type,
+                [current](const boost::system::error_code& error)
+                {
+                    if(error)
+                    {
+                        std::cout << "udp wait error: " << error << std::endl;
+                        exit(1);
+                    }
+                    coro::this_coroutine::detail::jump(current);
+                }
+                );
+
+        coro::this_coroutine::suspend();
+    }
+
+    void recv_loop()
+    {
+        std::size_t next_worker = 0;
+        for(;;)
+        {
+            wait(udp::socket::wait_read);
+
+            for(;;)
+            {
+                // only ask the kernel for as many packets as we have buffers
+                std::size_t count = 0;
+                while(count < batch_)
+                {
+                    auto p = pool_.acquire();
+                    if(!p) break;
+
+                    rx_[count] = p;
+                    rx_iovs_[count].iov_base = p->data.data();
+                    rx_iovs_[count].iov_len = Packet::capacity;
+
+                    std::memset(&rx_hdrs_[count], 0, sizeof(mmsghdr));
+                    rx_hdrs_[count].msg_hdr.msg_name = &p->addr;
+                    rx_hdrs_[count].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                    rx_hdrs_[count].msg_hdr.msg_iov = &rx_iovs_[count];
+                    rx_hdrs_[count].msg_hdr.msg_iovlen = 1;
+                    count++;
+                }
+
+                if(count == 0)
+                {
+                    // all buffers are held by handlers or queued replies.
+                    // the datagrams stay in the socket until one comes
+                    // back, the kernel drops what does not fit there
+                    coro::this_coroutine::yield();
+                    continue;
+                }
+
+                int n = ::recvmmsg(socket_.native_handle(), rx_hdrs_.data(), count, MSG_DONTWAIT, NULL);
+                stats_.rx_calls++;
+
+                int got = n > 0 ? n : 0;
+                for(std::size_t i=got; i<count; i++)
+                {
+                    pool_.release(rx_[i]);
+                }
+
+                if(n < 0)
+                {
+                    if(errno != EAGAIN && errno != EWOULDBLOCK)
+                    {
+                        std::cout << "recvmmsg error: " << std::strerror(errno) << std::endl;
+                    }
+                    break;
+                }
+
+                stats_.rx_packets += got;
+
+                dispatching_ = true;
+                for(int i=0; i<got; i++)
+                {
+                    auto p = rx_[i];
+                    if(rx_hdrs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+                    {
+                        // only the first Packet::capacity bytes arrived
+                        stats_.truncated++;
+                        pool_.release(p);
+                        continue;
+                    }
+
+                    p->size = rx_hdrs_[i].msg_len;
+                    p->addrlen = rx_hdrs_[i].msg_hdr.msg_namelen;
+
+                    auto& w = workers_[next_worker];
+                    next_worker = (next_worker + 1) % workers_.size();
+                    w.queue.put(p);
+                }
+                dispatching_ = false;
+
+                flush();
+
+                if(static_cast<std::size_t>(got) < count) break;
+            }
+        }
+    }
+
+    void worker_loop(Worker& w)
+    {
+        for(;;)
+        {
+            Packet* p = w.queue.get();
+
+            Datagram dgram(p, this);
+            callback_(dgram);
+
+            pool_.release(p);
+        }
+    }
+
+    void queue_reply(const Packet* to, const char* data, std::size_t size)
+    {
+        if(size > Packet::capacity)
+        {
+            std::cout << "udp reply too large: " << size << std::endl;
+            return;
+        }
+
+        auto p = pool_.acquire();
+        if(!p)
+        {
+            stats_.drops++;
+            return;
+        }
+
+        std::memcpy(p->data.data(), data, size);
+        p->size = size;
+        std::memcpy(&p->addr, &to->addr, to->addrlen);
+        p->addrlen = to->addrlen;
+        tx_.push_back(p);
+
+        // replies made while the recv loop is dispatching a batch
+        // are flushed at the end of that batch
+        if(!dispatching_ || tx_.size() >= batch_)
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        // another coroutine is waiting for the socket to be writable,
+        // it will send what we queued as well
+        if(flushing_) return;
+        flushing_ = true;
+
+        std::size_t sent = 0;
+        while(sent < tx_.size())
+        {
+            std::size_t count = std::min(batch_, tx_.size() - sent);
+            for(std::size_t i=0; i<count; i++)
+            {
+                auto p = tx_[sent + i];
+                tx_iovs_[i].iov_base = p->data.data();
+                tx_iovs_[i].iov_len = p->size;
+
+                std::memset(&tx_hdrs_[i], 0, sizeof(mmsghdr));
+                tx_hdrs_[i].msg_hdr.msg_name = &p->addr;
+                tx_hdrs_[i].msg_hdr.msg_namelen = p->addrlen;
+                tx_hdrs_[i].msg_hdr.msg_iov = &tx_iovs_[i];
+                tx_hdrs_[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            int n = ::sendmmsg(socket_.native_handle(), tx_hdrs_.data(), count, 0);
+            stats_.tx_calls++;
+
+            if(n < 0)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    wait(udp::socket::wait_write);
+                    continue;
+                }
+
+                std::cout << "sendmmsg error: " << std::strerror(errno) << std::endl;
+                stats_.drops += tx_.size() - sent;
+                break;
+            }
+
+            stats_.tx_packets += n;
+            sent += n;
+        }
+
+        for(auto p: tx_)
+        {
+            pool_.release(p);
+        }
+        tx_.clear();
+        flushing_ = false;
+    }
+
+    boost::asio::io_service& io_;
+    udp::socket socket_;
+    std::function<void(Datagram&)> callback_;
+    std::size_t batch_;
+    PacketPool pool_;
+    std::vector<Worker> workers_;
+    bool dispatching_;
+    bool flushing_;
+    UdpStats stats_;
+    coro::Scheduler* sche_;
+
+    std::vector<Packet*> rx_;
+    std::vector<mmsghdr> rx_hdrs_;
+    std::vector<iovec> rx_iovs_;
+
+    std::vector<Packet*> tx_;
+    std::vector<mmsghdr> tx_hdrs_;
+    std::vector<iovec> tx_iovs_;
+};
+
+
+inline void Datagram::reply(const char* data, std::size_t size)
+{
+    server_->queue_reply(packet_, data, size);
+}
+
+
+#endif // __CORO_UDP_SERVER_H__